@@ -3,15 +3,28 @@
  * Youtube: https://youtu.be/yXoMXTjhxLs
  * 
  * Yapısal Programlama Dersi Proje Ödevi
- * compile: gcc -ansi game.c
+ * compile: gcc -ansi game.c -lpthread
 */ 
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 #include <stdarg.h>
 #include <locale.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/eventfd.h>
 
 #define INVALID_PIECE 0
 #define NO_DIRECTION -1
@@ -33,6 +46,15 @@
 #define PADDING_TOP 3
 #define PADDING_LEFT 5
 
+/* Boards are at most 20x20, so every cell fits in 7 64-bit words */
+#define MAX_BOARD_SIZE 20
+#define MAX_CELLS (MAX_BOARD_SIZE * MAX_BOARD_SIZE)
+#define BB_WORDS ((MAX_CELLS + 63) / 64)
+
+#define BB_TEST(bb, idx) (((bb)[(idx) >> 6] >> ((idx) & 63)) & 1)
+#define BB_SET(bb, idx) ((bb)[(idx) >> 6] |= (uint64_t)1 << ((idx) & 63))
+#define BB_CLEAR(bb, idx) ((bb)[(idx) >> 6] &= ~((uint64_t)1 << ((idx) & 63)))
+
 
 typedef enum _Piece {
     EMPTY = ' ',
@@ -43,9 +65,27 @@ typedef enum _Piece {
     RED = 'E',
 } Piece;
 
+/* Bitboard representation of the cells. Cell (x, y) is bit x * size + y,
+ * occupied has a bit for every piece and colors[k] for every piece 'A' + k.
+ */
+typedef struct _BitBoard {
+    uint64_t occupied[BB_WORDS];
+    uint64_t colors[5][BB_WORDS];
+} BitBoard;
+
+/* cells is kept as a mirror of bits for rendering and saving, both are
+ * written only through setCell.
+ */
 typedef struct _Board {
     int size;
     Piece **cells;
+    BitBoard bits;
+    /* Zobrist hash of the cells, updated by setCell */
+    uint64_t hash;
+    /* constant masks for the jump generator, filled by allocBoard */
+    uint64_t cellMask[BB_WORDS];
+    uint64_t leftMask[BB_WORDS];
+    uint64_t rightMask[BB_WORDS];
 } Board;
 
 typedef enum _Direction {
@@ -55,6 +95,10 @@ typedef enum _Direction {
     RIGHT
 } Direction;
 
+/* Row and column step of each direction */
+const int directionDX[4] = { -1, 1, 0, 0 };
+const int directionDY[4] = { 0, 0, -1, 1 };
+
 typedef struct _Move {
     int playerId;
     int PieceX;
@@ -63,46 +107,524 @@ typedef struct _Move {
     struct _Move *next;
 } Move;
 
+/* A single jump: piece on cell index from jumps over its neighbour */
+typedef struct _Jump {
+    unsigned short from;
+    unsigned char direction;
+} Jump;
+
+typedef struct _JumpList {
+    int count;
+    Jump jumps[MAX_CELLS * 4];
+} JumpList;
+
+/* Cells that can start a jump, one mask per direction */
+typedef struct _JumpMask {
+    uint64_t from[4][BB_WORDS];
+} JumpMask;
+
+/* Longest possible chain, every hop takes one piece */
+#define MAX_CHAIN MAX_CELLS
+#define CHAIN_MEMO_SIZE (1 << 14)
+
+/* A full turn: the starting cell and every hop direction in order */
+typedef struct _Chain {
+    int from;
+    int length;
+    int score;
+    unsigned char dirs[MAX_CHAIN];
+} Chain;
+
+typedef struct _ChainMemoEntry {
+    uint64_t hash;
+    unsigned generation;
+    short landing;
+    signed char direction;
+    int score;
+} ChainMemoEntry;
+
+/* Scratch state of a chain search within one turn */
+typedef struct _ChainSearch {
+    Board *board;
+    int weights[5];
+    unsigned generation;
+    ChainMemoEntry *memo;
+    size_t memoMask;
+    /* findBestChain stops at this time, 0 for none, and sets stopped */
+    uint64_t deadline;
+    int stopped;
+} ChainSearch;
+
+/* Chain lists used by the game tree search */
+#define CHAIN_LIST_MAX 2048
+#define CHAIN_POOL_SIZE (1 << 16)
+#define CHAINS_MAXIMAL 1
+#define CHAINS_UNIQUE 2
+
+typedef struct _ChainRef {
+    short from;
+    short length;
+    int offset;
+    int order;
+    uint64_t endHash;
+} ChainRef;
+
+/* Chains with their directions stored back to back in pool */
+typedef struct _ChainList {
+    int count;
+    int poolUsed;
+    int truncated;
+    ChainRef chains[CHAIN_LIST_MAX];
+    unsigned char pool[CHAIN_POOL_SIZE];
+} ChainList;
+
 typedef enum _PlayerType {
     HUMAN,
     COMPUTER
 } PlayerType;
 
+/* Chains are stored in the transposition table with 2 bits per hop */
+#define TT_CHAIN_HOPS 64
+#define TT_DEFAULT_ENTRIES (1 << 16)
+
+typedef struct _PackedChain {
+    short from;
+    unsigned char length;
+    unsigned char dirs[TT_CHAIN_HOPS / 4];
+} PackedChain;
+
+typedef enum _Bound {
+    BOUND_EXACT,
+    BOUND_LOWER,
+    BOUND_UPPER
+} Bound;
+
+typedef struct _TTEntry {
+    uint64_t key;
+    int score;
+    unsigned char depth;
+    unsigned char bound;
+    unsigned char age;
+    /* index of the best chain in generateChains order, shared table only */
+    short move;
+    PackedChain chain;
+} TTEntry;
+
+/* Transposition table, two entries per bucket */
+typedef struct _TransTable {
+    TTEntry *entries;
+    size_t mask;
+    unsigned char age;
+    unsigned long probes;
+    unsigned long hits;
+} TransTable;
+
+/* Lock-free table shared by search threads. Each slot is two 64-bit
+ * words written independently: data and key ^ data. A torn write makes
+ * the xor check fail, so readers never see a mixed entry.
+ */
+typedef struct _SharedSlot {
+    uint64_t check;
+    uint64_t data;
+} SharedSlot;
+
+#define SHARED_BUCKET 4
+
+typedef struct _SharedTable {
+    SharedSlot *slots;
+    size_t mask;
+    unsigned char age;
+} SharedTable;
+
 typedef struct _Player {
     PlayerType type;
     int id;
     char name[50];
     int score;
     int pieces[5];
+    /* search memory of a computer player, kept for the whole game */
+    struct _SearchContext *search;
 } Player;
 
+typedef enum _AiMode {
+    AI_GREEDY,
+    AI_ALPHABETA,
+    AI_LAZYSMP
+} AiMode;
+
+/* Settings of the computer player. maxDepth 0 picks a default, which is
+ * unlimited when a per-move time budget is set.
+ */
+typedef struct _AiConfig {
+    size_t ttEntries;
+    AiMode mode;
+    int maxDepth;
+    unsigned moveTimeMs;
+    int threads;
+    /* the endgame solver plays once at most this many pieces are left */
+    int endgamePieces;
+} AiConfig;
+
+/* Exact endgame solver, see endgameSolve */
+#define ENDGAME_DEFAULT_PIECES 12
+#define ENDGAME_MAX_PIECES 24
+#define ENDGAME_TABLE (1 << 16)
+#define ENDGAME_NODE_LIMIT 250000
+
+AiConfig aiConfig = { TT_DEFAULT_ENTRIES, AI_GREEDY, 0, 0, 1, ENDGAME_DEFAULT_PIECES };
+
+/* What the last alpha-beta search reached */
+typedef struct _SearchInfo {
+    int depth;
+    unsigned long nodes;
+    uint64_t elapsedMs;
+} SearchInfo;
+
+SearchInfo lastSearch;
+
+/* Set by the self-play driver: no rendering, no messages, no saving */
+int headlessMode = 0;
+
+/* Set with --seed: new games are made by initBoardSeeded */
+int boardSeeded = 0;
+uint64_t boardSeed = 0;
+
+#define SEARCH_DEFAULT_DEPTH 4
+/* the clock is read once every SEARCH_CHECK_NODES nodes */
+#define SEARCH_CHECK_NODES 128
+#define SEARCH_MAX_PLY 32
+#define EVAL_SET 100
+#define EVAL_WIN 100000
+#define EVAL_INF 1000000
+
+/* State of one alpha-beta search, the root side moves at even plies */
+typedef struct _Search {
+    Board *board;
+    TransTable *tt;
+    /* used instead of tt when set */
+    SharedTable *shared;
+    /* set by another thread to end the search */
+    int *stop;
+    ChainList *lists;
+    unsigned long nodes;
+    int depthReached;
+    uint64_t deadline;
+    int stopped;
+    int abortable;
+    Chain pv;
+    Chain best;
+} Search;
+
+/* Negamax frames are large, search threads get a bigger stack */
+#define SEARCH_THREAD_STACK (16 * 1024 * 1024)
+#define MAX_THREADS 256
+
+/* One thread of the lazy SMP search */
+typedef struct _SmpWorker {
+    Search search;
+    Board *board;
+    Player me;
+    Player opp;
+    int startDepth;
+    int maxDepth;
+} SmpWorker;
+
+/* One thread of the root-parallel search */
+typedef struct _RootWorker {
+    Search search;
+    Board *board;
+    Player me;
+    Player opp;
+    ChainList *root;
+    int *order;
+    int index;
+    int stride;
+    int depth;
+    int bestValue;
+    int bestPos;
+} RootWorker;
+
+struct _WorkerPool;
+
+typedef struct _PoolThread {
+    struct _WorkerPool *pool;
+    int index;
+    pthread_t thread;
+} PoolThread;
+
+/* Search threads of a computer player, started once per game. A job
+ * runs on the caller as worker 0 and on every pool thread as worker
+ * 1, 2, ..., each on its own element of an argument array.
+ */
+typedef struct _WorkerPool {
+    PoolThread *threads;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    /* bumped for every job */
+    unsigned generation;
+    int running;
+    int quit;
+    void *(*job)(void *);
+    char *args;
+    size_t argSize;
+} WorkerPool;
+
+#define PERFT_MAX_DEPTH 16
+
+/* Open addressing set of 64-bit keys */
+typedef struct _KeySet {
+    uint64_t *keys;
+    size_t mask;
+    size_t count;
+} KeySet;
+
+/* Counters of a perft run, indexed by depth */
+typedef struct _Perft {
+    int depth;
+    int truncated;
+    ChainList *lists;
+    unsigned long nodes[PERFT_MAX_DEPTH + 1];
+    unsigned long chains[PERFT_MAX_DEPTH + 1];
+    unsigned long terminal[PERFT_MAX_DEPTH + 1];
+    KeySet positions[PERFT_MAX_DEPTH + 1];
+} Perft;
+
+/* Result of one self-play game */
+typedef struct _SelfPlayResult {
+    int turns;
+    int score[2];
+} SelfPlayResult;
+
+/* A self-play run shared by its worker threads */
+typedef struct _SelfPlay {
+    int size;
+    uint64_t seed;
+    int games;
+    int next;
+    SelfPlayResult *results;
+} SelfPlay;
+
+typedef struct _EndgameEntry {
+    uint64_t key;
+    int value;
+    unsigned char bound;
+    /* index of the best chain in generateChains order */
+    short best;
+} EndgameEntry;
+
+/* A solved position with its best chain, 2 bits per hop */
+#define SOLVED_CHAIN_HOPS 32
+
+typedef struct _SolvedRecord {
+    uint64_t key;
+    int value;
+    short from;
+    unsigned char length;
+    unsigned char dirs[SOLVED_CHAIN_HOPS / 4];
+} SolvedRecord;
+
+/* Memory of the endgame solver, allocated when it is first used */
+typedef struct _Endgame {
+    EndgameEntry *table;
+    size_t mask;
+    ChainList *lists;
+    int plies;
+    unsigned long limit;
+    /* a solve gives up at this time too, 0 for none */
+    uint64_t deadline;
+    unsigned long nodes;
+    int aborted;
+    /* when set, every solved position is added here once */
+    SolvedRecord *records;
+    size_t count;
+    size_t capacity;
+    /* keys of the records, open addressing, 0 for a free slot */
+    uint64_t *recorded;
+    size_t recordedMask;
+} Endgame;
+
+/* Everything a computer player's search needs, allocated once per game
+ * by createSearchContext so that a turn does no heap allocation. Thread
+ * 0 searches on the game board, the others on their own copies.
+ */
+typedef struct _SearchContext {
+    int size;
+    int threads;
+    AiMode mode;
+    ChainSearch chains;
+    TransTable *tt;
+    SharedTable *shared;
+    Board **boards;
+    ChainList **lists;
+    TransTable **workerTT;
+    RootWorker *rootWorkers;
+    SmpWorker *smpWorkers;
+    WorkerPool *pool;
+    ChainList *root;
+    int *order;
+    Endgame *endgame;
+    /* end of the current move's time budget, 0 for none */
+    uint64_t deadline;
+    SearchInfo info;
+} SearchContext;
+
+/* Shadow copy of what is on the terminal, used to repaint only the
+ * parts of a frame that changed.
+ */
+#define SCREEN_DIRTY 0
+#define SCREEN_CONTROL 1
+#define SCREEN_ERROR 2
+
+typedef struct _ScreenState {
+    int valid;
+    int size;
+    Piece cells[MAX_CELLS];
+    char names[2][64];
+    char entries[2][6][16];
+    char search[128];
+    int messages;
+    /* terminal lines the last error or debug message covers */
+    int errorLines;
+} ScreenState;
+
+ScreenState screen;
+
+/* Output of one frame. Everything the renderer draws, colour codes and
+ * cursor moves included, is composed here and sent with a single write
+ * when the outermost frame ends.
+ */
+typedef struct _FrameBuffer {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int depth;
+    size_t lastBytes;
+    unsigned long totalBytes;
+    unsigned long frames;
+} FrameBuffer;
+
+FrameBuffer frame;
+
+#define FRAME_CHUNK 1024
+
+void frameBegin()
+{
+    frame.depth++;
+}
+
+/* Write the composed frame to the terminal and count its bytes */
+void frameEnd()
+{
+    size_t done = 0;
+    ssize_t n;
+
+    if (--frame.depth > 0 || frame.length == 0)
+        return;
+    /* keep the order with whatever stdio still holds */
+    fflush(stdout);
+    while (done < frame.length)
+    {
+        n = write(STDOUT_FILENO, frame.data + done, frame.length - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    frame.lastBytes = frame.length;
+    frame.totalBytes += frame.length;
+    frame.frames++;
+    frame.length = 0;
+}
+
+/* Make room for `need` more bytes in the frame.
+ *
+ * Returns:
+ *     0 on success, -1 if the buffer cannot grow; it is left as it was.
+ */
+int frameReserve(size_t need)
+{
+    size_t capacity = frame.capacity;
+    char *data;
+
+    if (capacity - frame.length >= need)
+        return 0;
+    while (capacity - frame.length < need)
+        capacity = capacity ? capacity * 2 : 4 * FRAME_CHUNK;
+    data = (char *)realloc(frame.data, capacity);
+    if (data == NULL)
+        return -1;
+    frame.data = data;
+    frame.capacity = capacity;
+    return 0;
+}
+
+/* Append formatted text to the frame, growing it to fit. If memory
+ * runs out the text is cut to what fits.
+ */
+void frameVprintf(const char *format, va_list args)
+{
+    va_list again;
+    size_t room;
+    int n;
+
+    frameBegin();
+    __va_copy(again, args);
+    if (frameReserve(FRAME_CHUNK) == 0 || frame.capacity > frame.length)
+    {
+        room = frame.capacity - frame.length;
+        n = vsnprintf(frame.data + frame.length, room, format, args);
+        if (n >= 0 && (size_t)n >= room)
+        {
+            if (frameReserve((size_t)n + 1) == 0)
+                vsnprintf(frame.data + frame.length, (size_t)n + 1, format, again);
+            else
+                n = (int)room - 1;
+        }
+        if (n > 0)
+            frame.length += n;
+    }
+    va_end(again);
+    frameEnd();
+}
+
+void framePrintf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    frameVprintf(format, args);
+    va_end(args);
+}
+
 void moveCursor(int x, int y)
 {
-    printf("\033[%d;%dH", x, y);
+    framePrintf("\033[%d;%dH", x, y);
 }
 
 /* print at desired location on screen */
 void printAt(int x, int y, const char *text, ...)
 {
     va_list args;
-    printf("\033[s");
+    frameBegin();
+    framePrintf("\033[s");
     va_start(args, text);
-    printf("\033[%d;%dH", x, y);
-    vprintf(text, args);
+    framePrintf("\033[%d;%dH", x, y);
+    frameVprintf(text, args);
     va_end(args);
-    printf("\033[u");
+    framePrintf("\033[u");
+    frameEnd();
 }
 
 void clearScreen()
 {
-    printf("\033[2J");
-    printf("\033[H");
+    framePrintf("\033[2J\033[H");
 }
 
 void clearLine(int line)
 {
-    printf("\033[%d;0H", line);
-    printf("\033[K");
+    framePrintf("\033[%d;0H\033[K", line);
 }
 
 void clearLines(int start, int end)
@@ -116,42 +638,42 @@ void clearLines(int start, int end)
 
 void moveCursorToBottom()
 {
-    printf("\033[100;0H");
+    framePrintf("\033[100;0H");
 }
 
 void moveCursorToTop()
 {
-    printf("\033[0;0H");
+    framePrintf("\033[0;0H");
 }
 
 void moveCursorUp(int n)
 {
-    printf("\033[%dA", n);
+    framePrintf("\033[%dA", n);
 }
 
 void moveCursorDown(int n)
 {
-    printf("\033[%dB", n);
+    framePrintf("\033[%dB", n);
 }
 
 void moveCursorRight(int n)
 {
-    printf("\033[%dC", n);
+    framePrintf("\033[%dC", n);
 }
 
 void moveCursorLeft(int n)
 {
-    printf("\033[%dD", n);
+    framePrintf("\033[%dD", n);
 }
 
 void clearToEnd()
 {
-    printf("\033[K");
+    framePrintf("\033[K");
 }
 
 void clearToStart()
 {
-    printf("\033[1K");
+    framePrintf("\033[1K");
 }
 
 void clearInputBuffer()
@@ -163,1170 +685,7066 @@ void clearInputBuffer()
 
 void hideCursor()
 {
-    printf("\033[?25l");
+    framePrintf("\033[?25l");
 }
 
 void showCursor()
 {
-    printf("\033[?25h");
+    framePrintf("\033[?25h");
 }
 
 /* Print under the board */
 void printControl(Board *board, char *format, ...)
 {
+    frameBegin();
+    screen.messages |= SCREEN_CONTROL;
     moveCursor(PADDING_TOP + 4, PADDING_LEFT + 2 * board->size + 5);
     clearToEnd();
     va_list args;
     va_start(args, format);
-    printf(COLOR_RED "[Control] " COLOR_RESET);
-    vprintf(format, args);
+    framePrintf(COLOR_RED "[Control] " COLOR_RESET);
+    frameVprintf(format, args);
     va_end(args);
+    frameEnd();
+}
+
+/* Clear the lines of the last error or debug message */
+void clearErrorLines(Board *board)
+{
+    int line = PADDING_TOP + board->size + 2;
+    if (screen.messages & SCREEN_ERROR)
+        clearLines(line, line + screen.errorLines - 1);
+    screen.messages &= ~SCREEN_ERROR;
+}
+
+/* Lines under the board the frame text from `from` on covers. A
+ * trailing newline does not start a line of its own.
+ */
+int frameLinesSince(size_t from)
+{
+    int lines = 1;
+    size_t i;
+    for (i = from; i + 1 < frame.length; i++)
+    {
+        if (frame.data[i] == '\n')
+            lines++;
+    }
+    return lines;
 }
 
 void printDebug(Board *board, char *format, ...)
 {
     va_list args;
+    size_t from;
     va_start(args, format);
+    frameBegin();
+    clearErrorLines(board);
     moveCursor(PADDING_TOP + board->size + 2, 0);
     clearToEnd();
-    printf(COLOR_GREEN "[Debug] " COLOR_RESET);
-    vprintf(format, args);
+    from = frame.length;
+    framePrintf(COLOR_GREEN "[Debug] " COLOR_RESET);
+    frameVprintf(format, args);
     va_end(args);
+    screen.messages |= SCREEN_ERROR;
+    screen.errorLines = frameLinesSince(from);
+    frameEnd();
 }
 
 void printError(Board *board, char *format, ...)
 {
     va_list args;
+    size_t from;
     va_start(args, format);
+    frameBegin();
+    clearErrorLines(board);
     moveCursor(PADDING_TOP + board->size + 2, 0);
     clearToEnd();
-    printf(COLOR_RED "[Error] " COLOR_RESET);
-    vprintf(format, args);
+    from = frame.length;
+    framePrintf(COLOR_RED "[Error] " COLOR_RESET);
+    frameVprintf(format, args);
     va_end(args);
+    screen.messages |= SCREEN_ERROR;
+    screen.errorLines = frameLinesSince(from);
+    frameEnd();
 }
 
-/* Check if the move is valid
- *
- * Parameters:
- * - board: the game board
- * - move: the move to be checked
- *
- * Returns:
- * - INVALID_PIECE if the move is invalid
- * - Piece: the piece that is taken by the move
-*/
-Piece isMoveValid(Board *board, Move *move)
+/* Zobrist keys, seeded once with a fixed seed so hashes are the same in
+ * every run and can be stored on disk.
+ */
+uint64_t zobristCells[MAX_CELLS][5];
+uint64_t zobristPieces[2][5][MAX_CELLS + 1];
+uint64_t zobristSide[2];
+int zobristReady = 0;
+
+uint64_t splitmix64(uint64_t *state)
 {
-    int toRight = move->direction == RIGHT ? 1 : move->direction == LEFT ? -1 : 0;
-    int toBottom = move->direction == DOWN ? 1 : move->direction == UP ? -1 : 0;
-    Piece c;
-    if (board->size <= move->PieceX + 2 * toBottom || move->PieceX + 2 * toBottom < 0)
-    {
-        return INVALID_PIECE;
-    }
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
 
-    if (board->size <= move->PieceY + 2 * toRight || move->PieceY + 2 * toRight < 0)
+void initZobrist()
+{
+    uint64_t seed = 0x5CA1AB1E;
+    int i, k, p;
+    if (zobristReady)
+        return;
+    for (i = 0; i < MAX_CELLS; i++)
     {
-        return INVALID_PIECE;
+        for (k = 0; k < 5; k++)
+        {
+            zobristCells[i][k] = splitmix64(&seed);
+        }
     }
-
-    c = board->cells[move->PieceX + toBottom][move->PieceY + toRight];
-    if (c == EMPTY)
+    for (p = 0; p < 2; p++)
     {
-        return INVALID_PIECE;
+        for (k = 0; k < 5; k++)
+        {
+            for (i = 0; i <= MAX_CELLS; i++)
+            {
+                zobristPieces[p][k][i] = splitmix64(&seed);
+            }
+        }
+        zobristSide[p] = splitmix64(&seed);
     }
+    zobristReady = 1;
+}
 
-    if (board->cells[move->PieceX + 2 * toBottom][move->PieceY + 2 * toRight] != EMPTY)
+/* Recompute the board hash from scratch.
+ *
+ * Parameters:
+ *     board: the game board
+ *
+ * Returns:
+ *     The Zobrist hash of the cells, also stored in board->hash.
+ */
+uint64_t computeBoardHash(Board *board)
+{
+    int i;
+    Piece p;
+    board->hash = 0;
+    for (i = 0; i < board->size * board->size; i++)
     {
-        return INVALID_PIECE;
+        p = board->cells[0][i];
+        if (p != EMPTY)
+            board->hash ^= zobristCells[i][p - 'A'];
     }
-
-    return c;
+    return board->hash;
 }
 
-/* Save player to file. This will append to the file
+/* Hash of a whole game position: the cells, both players' pieces and
+ * the side to move. Combining the keys is O(1).
  *
  * Parameters:
- *     filename: name of the file to be written.
- *     player: pointer to the player struct to be saved.
+ *     board: the game board
+ *     toMove: the player whose turn it is
+ *     other: the other player
  */
-void savePlayer(char *filename, Player *player)
+uint64_t positionKey(Board *board, Player *toMove, Player *other)
 {
-    FILE *file;
-    /* open in append mode */
-    file = fopen(filename, "a");
-    if (file == NULL)
+    uint64_t key = board->hash ^ zobristSide[(toMove->id - 1) & 1];
+    int k, n;
+    for (k = 0; k < 5; k++)
     {
-        printf("File not found\n");
-        exit(1);
+        n = toMove->pieces[k] < 0 ? 0 : toMove->pieces[k] > MAX_CELLS ? MAX_CELLS : toMove->pieces[k];
+        key ^= zobristPieces[(toMove->id - 1) & 1][k][n];
+        n = other->pieces[k] < 0 ? 0 : other->pieces[k] > MAX_CELLS ? MAX_CELLS : other->pieces[k];
+        key ^= zobristPieces[(other->id - 1) & 1][k][n];
     }
-    fprintf(file, "player: id: %d, type: %d, name: %s\n", player->id, player->type, player->name);
-    fclose(file);
+    return key;
 }
 
-/* Load player from file with given id.
+/* Key of a position for the alpha-beta tables. Their values come from
+ * evaluate, which counts the sets already completed, so the difference
+ * of the scores is part of the key as well.
+ */
+uint64_t searchKey(Board *board, Player *toMove, Player *other)
+{
+    uint64_t lead = (uint64_t)(int64_t)(toMove->score - other->score);
+    return positionKey(board, toMove, other) ^ splitmix64(&lead);
+}
+
+/* Allocate an empty board of size N x N. Cells are stored in one
+ * contiguous block and the bitboards start out empty.
  *
  * Parameters:
- *     filename: name of the file which player is located.
- *     playerId: Id of the player
+ *     N: the size of the board (N x N).
+ *
+ * Returns:
+ *     A pointer to the allocated Board structure.
  */
-Player *loadPlayer(char *filename, int playerId)
+Board *allocBoard(int N)
 {
-    FILE *file;
-    Player *player;
-    char name[100];
-    int id, type;
-    file = fopen(filename , "r");
-    char line[100];
-    if (file == NULL)
+    int i;
+    Board *board = (Board *)malloc(sizeof(Board));
+    board->size = N;
+    board->cells = (Piece **)malloc(N * sizeof(Piece *));
+    board->cells[0] = (Piece *)malloc(N * N * sizeof(Piece));
+    for (i = 0; i < N; i++)
     {
-        printf("File not found\n");
-        exit(1);
+        board->cells[i] = board->cells[0] + i * N;
     }
-    player = (Player *)malloc(sizeof(Player));
-
-    while (fgets(line, 100, file) != NULL)
+    for (i = 0; i < N * N; i++)
     {
-        if (sscanf(line, "player: id: %d, type: %d, name: %s", &id, &type, name) == 3)
-        {
-            if (id == playerId)
-            {
-                player->id = id;
-                player->type = type;
-                strncpy(player->name, name, 50);
-            }
-        }
+        board->cells[0][i] = EMPTY;
+    }
+    initZobrist();
+    memset(&board->bits, 0, sizeof(BitBoard));
+    board->hash = 0;
+    memset(board->cellMask, 0, sizeof(board->cellMask));
+    memset(board->leftMask, 0, sizeof(board->leftMask));
+    memset(board->rightMask, 0, sizeof(board->rightMask));
+    for (i = 0; i < N * N; i++)
+    {
+        BB_SET(board->cellMask, i);
+        /* a piece needs two columns of room to jump sideways */
+        if (i % N >= 2)
+            BB_SET(board->leftMask, i);
+        if (i % N < N - 2)
+            BB_SET(board->rightMask, i);
     }
+    return board;
+}
 
-    fclose(file);
-    return player;
+/* Copy the cells of a board into another board of the same size */
+void copyBoardInto(Board *dst, Board *src)
+{
+    memcpy(dst->cells[0], src->cells[0], src->size * src->size * sizeof(Piece));
+    dst->bits = src->bits;
+    dst->hash = src->hash;
 }
 
-/* Save the player's move to a file.
+/* Make an independent copy of a board */
+Board *copyBoard(Board *board)
+{
+    Board *copy = allocBoard(board->size);
+    copyBoardInto(copy, board);
+    return copy;
+}
+
+/* Set the piece on a cell, keeping the bitboards, cells and hash in sync.
  *
  * Parameters:
- *     filename: name of the file where the move will be saved.
- *     player: pointer to the Player structure containing player details.
- *     move: the move to be saved.
+ *     board: the game board
+ *     x, y: coordinates of the cell
+ *     p: the new piece, EMPTY clears the cell
  */
-void saveMove(char *filename, Move move)
+void setCell(Board *board, int x, int y, Piece p)
 {
-    FILE *file;
-    file = fopen(filename, "a");
-    if (file == NULL)
+    int idx = x * board->size + y;
+    Piece old = board->cells[x][y];
+    if (old != EMPTY)
     {
-        printf("File not found\n");
-        exit(1);
+        BB_CLEAR(board->bits.occupied, idx);
+        BB_CLEAR(board->bits.colors[old - 'A'], idx);
+        board->hash ^= zobristCells[idx][old - 'A'];
     }
-    fprintf(file, "move: player: %d, x: %d, y: %d, direction: %d\n", move.playerId, move.PieceX, move.PieceY, move.direction);
-    fclose(file);
+    if (p != EMPTY)
+    {
+        BB_SET(board->bits.occupied, idx);
+        BB_SET(board->bits.colors[p - 'A'], idx);
+        board->hash ^= zobristCells[idx][p - 'A'];
+    }
+    board->cells[x][y] = p;
 }
 
-/* Load the game board from a file.
- *
- * Parameters:
- *     filename: name of the file which contains the board data.
+/* Check whether a cell is occupied using the occupancy mask */
+int isCellOccupied(Board *board, int x, int y)
+{
+    return (int)BB_TEST(board->bits.occupied, x * board->size + y);
+}
+
+/* Read the piece on a cell from the bitplanes.
  *
  * Returns:
- *     A pointer to the Board structure with the loaded data.
+ *     EMPTY if the cell is empty, otherwise the piece on it.
  */
-Board* loadBoard(char *filename)
+Piece pieceAt(Board *board, int x, int y)
 {
-    FILE *file;
-    Board *board;
-    int i, j;
-    char c;
-    file = fopen(filename, "r");
-    if (file == NULL)
+    int idx = x * board->size + y;
+    int k;
+    if (!BB_TEST(board->bits.occupied, idx))
     {
-        printf("File not found\n");
-        exit(1);
+        return EMPTY;
     }
-    board = (Board *)malloc(sizeof(Board));
-    fscanf(file, "size: %d\n", &board->size);
-    fscanf(file, "board:\n");
-    board->cells = (Piece **)malloc(board->size * sizeof(Piece *));
-    for (i = 0; i < board->size; i++)
+    for (k = 0; k < 4; k++)
     {
-        board->cells[i] = (Piece *)malloc(board->size * sizeof(Piece));
-        for (j = 0; j < board->size; j++)
+        if (BB_TEST(board->bits.colors[k], idx))
         {
-            fscanf(file, "%c", &c);
-            board->cells[i][j] = c;
+            return 'A' + k;
         }
-        fscanf(file, "\n");
     }
-    fclose(file);
-    return board;
+    return RED;
 }
 
-/* Initialize a game board with given size N.
- *
- * Parameters:
- *     N: the size of the board (N x N).
- *
- * Returns:
- *     A pointer to the initialized Board structure with size N x N.
- */
-Board *initBoard(int N)
+/* dst = src shifted towards higher cell indices by n bits */
+void bbShiftUp(uint64_t *dst, const uint64_t *src, int n)
 {
-    int i, j, random;
-    Piece p;
-    Board *board;
-    if (N % 2 != 0)
+    int words = n >> 6, bits = n & 63;
+    int i;
+    for (i = BB_WORDS - 1; i >= 0; i--)
     {
-        printf("Board size must be an even number\n");
-        return NULL;
+        uint64_t v = 0;
+        if (i - words >= 0)
+        {
+            v = src[i - words] << bits;
+            if (bits && i - words - 1 >= 0)
+                v |= src[i - words - 1] >> (64 - bits);
+        }
+        dst[i] = v;
     }
+}
 
-    board = (Board *)malloc(sizeof(Board));
-    board->size = N;
-    board->cells = (Piece **)malloc(N * sizeof(Piece *));
-    for (i = 0; i < N; i++)
+/* dst = src shifted towards lower cell indices by n bits */
+void bbShiftDown(uint64_t *dst, const uint64_t *src, int n)
+{
+    int words = n >> 6, bits = n & 63;
+    int i;
+    for (i = 0; i < BB_WORDS; i++)
     {
-        board->cells[i] = (Piece *)malloc(N * sizeof(Piece));
-        for (j = 0; j < N; j++)
+        uint64_t v = 0;
+        if (i + words < BB_WORDS)
         {
-            /* check if the cell is in the middle */
-            if ( (i == N/2-1 || i == N/2) && (j == N/2-1 || j == N/2) )
-            {
-                board->cells[i][j] = EMPTY;
-            }
-            else 
-            {
-                random = rand() % 5;
-                p = 'A' + random;
-                board->cells[i][j] = p;
-            }
+            v = src[i + words] >> bits;
+            if (bits && i + words + 1 < BB_WORDS)
+                v |= src[i + words + 1] << (64 - bits);
         }
+        dst[i] = v;
     }
-
-    return board;
 }
 
-/* Save the game board to a file.
+/* Find every legal jump on the board at once. A cell can jump in a
+ * direction when it is occupied, the next cell is occupied and the one
+ * after it is empty. Each test is a shift of the whole bitboard.
  *
  * Parameters:
- *     board: pointer to the Board structure containing the board data.
- *     filename: name of the file where the board will be saved.
+ *     board: the game board
+ *     mask: filled with the starting cells for each direction
+ *
+ * Returns:
+ *     1 if at least one jump exists, 0 otherwise.
  */
-void saveBoard(Board *board, char *filename)
+int generateJumpMask(Board *board, JumpMask *mask)
 {
-    FILE *file;
-    int i, j;
-    file = fopen(filename, "w");
-    if (file == NULL)
+    uint64_t empty[BB_WORDS], over[BB_WORDS], land[BB_WORDS];
+    const uint64_t *occ = board->bits.occupied;
+    int N = board->size;
+    uint64_t any = 0;
+    int i;
+
+    for (i = 0; i < BB_WORDS; i++)
     {
-        printf("File not found\n");
-        exit(1);
+        empty[i] = board->cellMask[i] & ~occ[i];
     }
-    fprintf(file, "size: %d\n", board->size);
-    fprintf(file, "board:\n");
-    for (i = 0; i < board->size; i++)
+
+    /* UP: over is x - 1, landing is x - 2 */
+    bbShiftUp(over, occ, N);
+    bbShiftUp(land, empty, 2 * N);
+    for (i = 0; i < BB_WORDS; i++)
     {
-        for (j = 0; j < board->size; j++)
-        {
-            fprintf(file, "%c", board->cells[i][j]);
-        }
-        fprintf(file, "\n");
+        mask->from[UP][i] = occ[i] & over[i] & land[i];
+        any |= mask->from[UP][i];
     }
-    fclose(file);
+
+    /* DOWN: over is x + 1, landing is x + 2 */
+    bbShiftDown(over, occ, N);
+    bbShiftDown(land, empty, 2 * N);
+    for (i = 0; i < BB_WORDS; i++)
+    {
+        mask->from[DOWN][i] = occ[i] & over[i] & land[i];
+        any |= mask->from[DOWN][i];
+    }
+
+    /* LEFT: over is y - 1, landing is y - 2 */
+    bbShiftUp(over, occ, 1);
+    bbShiftUp(land, empty, 2);
+    for (i = 0; i < BB_WORDS; i++)
+    {
+        mask->from[LEFT][i] = occ[i] & over[i] & land[i] & board->leftMask[i];
+        any |= mask->from[LEFT][i];
+    }
+
+    /* RIGHT: over is y + 1, landing is y + 2 */
+    bbShiftDown(over, occ, 1);
+    bbShiftDown(land, empty, 2);
+    for (i = 0; i < BB_WORDS; i++)
+    {
+        mask->from[RIGHT][i] = occ[i] & over[i] & land[i] & board->rightMask[i];
+        any |= mask->from[RIGHT][i];
+    }
+
+    return any != 0;
 }
 
-/* Create a new move with specified coordinates and direction.
+/* Check if the board has any legal jump */
+int anyJumpAvailable(Board *board)
+{
+    JumpMask mask;
+    return generateJumpMask(board, &mask);
+}
+
+/* List every legal jump as (from, direction) pairs, ordered by the
+ * starting cell and then by direction.
  *
  * Parameters:
- *     x: the x-coordinate of the move.
- *     y: the y-coordinate of the move.
- *     direction: the direction of the move.
+ *     board: the game board
+ *     list: filled with the jumps
  *
  * Returns:
- *     A pointer to the newly created Move structure.
+ *     The number of jumps found.
  */
-Move *createMove(int x, int y, Direction direction)
+int generateJumps(Board *board, JumpList *list)
 {
-    Move *move = (Move *)malloc(sizeof(Move));
-    move->PieceX = x;
-    move->PieceY = y;
-    move->direction = direction;
-    move->next = NULL;
-    move->playerId = 0;
-    return move;
+    JumpMask mask;
+    uint64_t bits;
+    int i, d, idx;
+
+    list->count = 0;
+    if (!generateJumpMask(board, &mask))
+    {
+        return 0;
+    }
+
+    for (i = 0; i < BB_WORDS; i++)
+    {
+        bits = mask.from[UP][i] | mask.from[DOWN][i] | mask.from[LEFT][i] | mask.from[RIGHT][i];
+        while (bits)
+        {
+            idx = __builtin_ctzll(bits);
+            bits &= bits - 1;
+            for (d = UP; d <= RIGHT; d++)
+            {
+                if ((mask.from[d][i] >> idx) & 1)
+                {
+                    list->jumps[list->count].from = i * 64 + idx;
+                    list->jumps[list->count].direction = d;
+                    list->count++;
+                }
+            }
+        }
+    }
+    return list->count;
 }
 
-/* Free the memory allocated for the game board.
+/* Check if the move is valid
  *
  * Parameters:
- *     board: pointer to the Board structure to be freed.
- */
-void freeBoard(Board *board)
+ * - board: the game board
+ * - move: the move to be checked
+ *
+ * Returns:
+ * - INVALID_PIECE if the move is invalid
+ * - Piece: the piece that is taken by the move
+*/
+Piece isMoveValid(Board *board, Move *move)
 {
-    int i;
-    for (i = 0; i < board->size; i++)
+    int toRight = move->direction == RIGHT ? 1 : move->direction == LEFT ? -1 : 0;
+    int toBottom = move->direction == DOWN ? 1 : move->direction == UP ? -1 : 0;
+    Piece c;
+    if (board->size <= move->PieceX + 2 * toBottom || move->PieceX + 2 * toBottom < 0)
     {
-        free(board->cells[i]);
+        return INVALID_PIECE;
     }
-    free(board->cells);
-    free(board);
+
+    if (board->size <= move->PieceY + 2 * toRight || move->PieceY + 2 * toRight < 0)
+    {
+        return INVALID_PIECE;
+    }
+
+    if (!isCellOccupied(board, move->PieceX + toBottom, move->PieceY + toRight))
+    {
+        return INVALID_PIECE;
+    }
+
+    if (isCellOccupied(board, move->PieceX + 2 * toBottom, move->PieceY + 2 * toRight))
+    {
+        return INVALID_PIECE;
+    }
+
+    c = pieceAt(board, move->PieceX + toBottom, move->PieceY + toRight);
+    return c;
 }
 
-/* Update the player's score based on the pieces they have.
+/* Save file journal. The file stays open for the whole game and records
+ * are buffered; when they reach the disk depends on the sync mode:
  *
- * Parameters:
- *     p1: pointer to the Player structure whose score will be updated.
+ *     SYNC_TURN: written after every turn
+ *     SYNC_EVERY: written every `every` turns
+ *     SYNC_EXIT: written when the buffer fills up
+ *
+ * In every mode the journal is written and fsynced when the game ends,
+ * when the program exits and on SIGINT, SIGTERM and SIGHUP.
+ *
+ * Every `checkpointEvery` turns the game also saves a checkpoint of the
+ * board and the players, so loading does not replay the whole game.
+ *
+ * With `async` set, the game thread only puts the records into a
+ * single-producer single-consumer ring and a writer thread does the
+ * buffering and the writes, so a turn never waits for the disk.
  */
-void loadScores(Player *p1)
+#define JOURNAL_BUFFER (1 << 16)
+/* default turns between two checkpoints in a save file */
+#define CHECKPOINT_TURNS 16
+#define JOURNAL_RECORD 512
+
+/* Binary save format, version 2. All numbers are little endian.
+ *
+ *     header: "SKPB", version, board size, player count, reserved
+ *     players: id, type, name length, name bytes
+ *     board: cells in row order, 3 bits each, low bits first,
+ *         0 for an empty cell and 1-5 for A-E
+ *     moves: 2 bytes each until the end of the file, bits 0-8 the from
+ *         cell (x * size + y), 9-10 the direction, 11 the player id - 1
+ *
+ * Version 2 adds checkpoints between the moves: the word 0xffff, the
+ * next player and a reserved byte, both scores and the ten piece counts
+ * as 16-bit numbers, the packed board and a pad byte to an even length.
+ * Version 1 files are read as well.
+ */
+#define BINARY_MAGIC "SKPB"
+#define BINARY_VERSION 2
+#define BINARY_HEADER 8
+#define BINARY_MOVE 2
+#define BINARY_CHECKPOINT 0xffff
+#define PACKED_BOARD(size) (((size) * (size) * 3 + 7) / 8)
+#define CHECKPOINT_BYTES(size) ((2 + 2 + 24 + PACKED_BOARD(size) + 1) / 2 * 2)
+
+/* Board and players at some point of a saved game. `move` is the number
+ * of moves played before it.
+ */
+typedef struct _Checkpoint {
+    int move;
+    int next;
+    int score[2];
+    int pieces[2][5];
+    Piece cells[MAX_CELLS];
+} Checkpoint;
+
+/* Little-endian integers of the file formats */
+uint32_t get32(const unsigned char *p)
 {
-    int scoreAvail = 1;
-    int i;
-    while (scoreAvail)
-    {
-        for (i = 0; i < 5; i++)
-        {
-            if (p1->pieces[i] == 0)
-            {
-                scoreAvail = 0;
-            }
-        }
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
 
-        if (scoreAvail)
-        {
-            p1->score++;
-            for (i = 0; i < 5; i++)
-            {
-                p1->pieces[i]--;
-            }
-        }
-    }
+uint64_t get64(const unsigned char *p)
+{
+    return get32(p) | (uint64_t)get32(p + 4) << 32;
 }
 
-void renderBoard(Board *board);
-void movePiece(Board *board, Move *move);
-void loadMoves(char *filename, Board *board, Player *player1, Player *player2, int* lastPlayerId)
+void put32(unsigned char *p, uint32_t value)
 {
-    FILE *file;
-    Move *move = createMove(0, 0, 0);
-    char line[100];
-    int x, y, direction, playerId;
-    file = fopen(filename, "r");
-    if (file == NULL)
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+void put64(unsigned char *p, uint64_t value)
+{
+    put32(p, (uint32_t)value);
+    put32(p + 4, (uint32_t)(value >> 32));
+}
+
+/* Pack cells at 3 bits each into zeroed data */
+void packCells(unsigned char *data, const Piece *cells, int count)
+{
+    int k, bit, code;
+    for (k = 0; k < count; k++)
     {
-        printf("File not found\n");
-        exit(1);
+        code = cells[k] >= 'A' && cells[k] <= 'E' ? cells[k] - 'A' + 1 : 0;
+        bit = k * 3;
+        data[bit / 8] |= code << (bit % 8);
+        if (bit % 8 > 5)
+            data[bit / 8 + 1] |= code >> (8 - bit % 8);
     }
-    int lastId = 2;
-    *lastPlayerId = 1;
-    while (fgets(line, 100, file) != NULL)
+}
+
+void unpackCells(const unsigned char *data, Piece *cells, int count)
+{
+    int k, bit, code;
+    for (k = 0; k < count; k++)
     {
-        if (sscanf(line, "move: player: %d, x: %d, y: %d, direction: %d", &playerId, &x, &y, &direction) == 4)
-        {
-            move->PieceX = x;
-            move->PieceY = y;
-            move->direction = direction;
-            move->playerId = playerId;
-            move->next = NULL;
-            Piece c = isMoveValid(board, move);
-            movePiece(board, move);
-            if (c == INVALID_PIECE)
-            {
-                renderBoard(board);
-                printError(board, "Invalid move, x: %d, y: %d, direction: %d\n", x, y, direction);
-                exit(1);
-            }
-            /* give point to accourding player */
-            if (player1->id == playerId)
-            {
-                player1->pieces[c - 'A']++;
-            }
-            else if (player2->id == playerId)
-            {
-                player2->pieces[c - 'A']++;
-            }
-            lastId = playerId;
-        }
+        bit = k * 3;
+        code = (data[bit / 8] | (bit % 8 > 5 ? data[bit / 8 + 1] << 8 : 0)) >> (bit % 8) & 7;
+        cells[k] = code >= 1 && code <= 5 ? 'A' + code - 1 : EMPTY;
     }
-    if (lastId == 2)
-        *lastPlayerId = 1;
-    else
-        *lastPlayerId = 2;
-    fclose(file);
 }
 
-/* Print the board */
-void printBoard(Board *board)
+/* Encode a checkpoint record, marker included, into zeroed data */
+void encodeCheckpoint(unsigned char *data, int size, const Checkpoint *checkpoint)
 {
-    int i, j;
-    for (i = 0; i < board->size; i++)
+    int i, k;
+    data[0] = data[1] = 0xff;
+    data[2] = checkpoint->next;
+    for (i = 0; i < 2; i++)
     {
-        for (j = 0; j < board->size; j++)
+        data[4 + 2 * i] = checkpoint->score[i] & 0xff;
+        data[5 + 2 * i] = checkpoint->score[i] >> 8;
+        for (k = 0; k < 5; k++)
         {
-            switch (board->cells[i][j])
-            {
-            case BLUE:
-                printf(COLOR_BLUE "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case GREEN:
-                printf(COLOR_GREEN "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case YELLOW:
-                printf(COLOR_YELLOW "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case ORANGE:
-                printf(COLOR_ORANGE "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case RED:
-                printf(COLOR_RED "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case EMPTY:
-                printf("%c ", board->cells[i][j]);
-                break;
-            }
+            data[8 + 10 * i + 2 * k] = checkpoint->pieces[i][k] & 0xff;
+            data[9 + 10 * i + 2 * k] = checkpoint->pieces[i][k] >> 8;
         }
-        printf("\n");
     }
+    packCells(data + 28, checkpoint->cells, size * size);
 }
 
-void whitePiece(Board *board, int x, int y)
+void decodeCheckpoint(const unsigned char *data, int size, Checkpoint *checkpoint)
 {
-    moveCursor(PADDING_TOP + x + 1, PADDING_LEFT + 2 * (y + 1));
-    printf(COLOR_WHITE "\033[1m%c " COLOR_RESET, board->cells[x][y]);
+    int i, k;
+    checkpoint->next = data[2];
+    for (i = 0; i < 2; i++)
+    {
+        checkpoint->score[i] = data[4 + 2 * i] | data[5 + 2 * i] << 8;
+        for (k = 0; k < 5; k++)
+            checkpoint->pieces[i][k] = data[8 + 10 * i + 2 * k] | data[9 + 10 * i + 2 * k] << 8;
+    }
+    unpackCells(data + 28, checkpoint->cells, size * size);
 }
 
-void renderBoard(Board *board)
+/* Parse a text checkpoint record of a board of the given size.
+ *
+ * Returns:
+ *     1 on success, 0 if the line is not a valid checkpoint.
+ */
+int parseCheckpoint(const char *line, int size, Checkpoint *checkpoint)
 {
-    int i, j;
-    moveCursor(PADDING_TOP, PADDING_LEFT);
+    int *p = &checkpoint->pieces[0][0];
+    int offset = -1, k;
+    if (sscanf(line, "checkpoint: next: %d, score: %d %d, pieces: %d %d %d %d %d %d %d %d %d %d, board: %n",
+               &checkpoint->next, &checkpoint->score[0], &checkpoint->score[1],
+               p, p + 1, p + 2, p + 3, p + 4, p + 5, p + 6, p + 7, p + 8, p + 9, &offset) != 13 ||
+        offset < 0 || (int)strlen(line + offset) < size * size)
+        return 0;
+    for (k = 0; k < size * size; k++)
+        checkpoint->cells[k] = line[offset + k] >= 'A' && line[offset + k] <= 'E' ? line[offset + k] : EMPTY;
+    return checkpoint->next == 1 || checkpoint->next == 2;
+}
 
-    for (i = 0; i <= board->size; i++)
+/* Put the board and the players in the state of a checkpoint */
+void applyCheckpoint(const Checkpoint *checkpoint, Board *board, Player *player1, Player *player2)
+{
+    int k;
+    for (k = 0; k < board->size * board->size; k++)
+        setCell(board, k / board->size, k % board->size, checkpoint->cells[k]);
+    computeBoardHash(board);
+    player1->score = checkpoint->score[0];
+    player2->score = checkpoint->score[1];
+    for (k = 0; k < 5; k++)
     {
-        if (i < 10)
-        {
-            printf(COLOR_BOLD "%d " RESET, i);
-        }
-        else
-        {
-            printf(COLOR_BOLD "%c " RESET, 'A' + i - 10);
-        }
+        player1->pieces[k] = checkpoint->pieces[0][k];
+        player2->pieces[k] = checkpoint->pieces[1][k];
     }
+}
+#define RING_SLOTS 1024
+/* how long a signal handler waits for the writer to drain the ring */
+#define RING_DRAIN_MS 1000
 
-    for (i = 1; i <= board->size; i++)
-    {
-        moveCursor(PADDING_TOP + i, PADDING_LEFT);
-        if (i < 10)
-        {
-            printf(COLOR_BOLD "%d " RESET, i);
-        }
-        else
-        {
-            printf(COLOR_BOLD "%c " RESET, 'A' + i - 10);
-        }
-    }
+typedef enum _JournalSync {
+    SYNC_TURN,
+    SYNC_EVERY,
+    SYNC_EXIT
+} JournalSync;
 
-    for (i = 0; i < board->size; i++)
+typedef enum _RecordKind {
+    RECORD_TEXT,
+    RECORD_TURN
+} RecordKind;
+
+typedef struct _RingSlot {
+    RecordKind kind;
+    int length;
+    char text[JOURNAL_RECORD];
+} RingSlot;
+
+/* head is only written by the game thread, tail only by the writer.
+ * A side that finds nothing to do sets its waiting flag, checks again
+ * and blocks on its eventfd; the other side only signals the eventfd
+ * when the flag is set, so a busy ring makes no system calls.
+ */
+typedef struct _JournalRing {
+    size_t head;
+    size_t tail;
+    int stop;
+    int done;
+    int writerWaiting;
+    int gameWaiting;
+    /* eventfds: records or stop for the writer, room for the game
+     * thread, and the writer has finished
+     */
+    int wakeWriter;
+    int wakeGame;
+    int finished;
+    RingSlot slots[RING_SLOTS];
+} JournalRing;
+
+typedef struct _Journal {
+    int fd;
+    char path[256];
+    JournalSync sync;
+    int every;
+    int turns;
+    int handlers;
+    int async;
+    int writing;
+    int binary;
+    int binarySize;
+    int binaryVersion;
+    int checkpointEvery;
+    pthread_t writer;
+    JournalRing *ring;
+    size_t length;
+    char buffer[JOURNAL_BUFFER];
+} Journal;
+
+Journal journal;
+
+/* Set the journal defaults, before the options change them */
+void journalInit()
+{
+    journal.fd = -1;
+    journal.sync = SYNC_TURN;
+    journal.every = 1;
+    journal.checkpointEvery = CHECKPOINT_TURNS;
+}
+
+/* Wake the side blocked on an eventfd. Safe in a signal handler. */
+void ringNotify(int fd)
+{
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR)
+        ;
+}
+
+/* Block until an eventfd is signalled */
+void ringBlock(int fd)
+{
+    uint64_t count;
+    while (read(fd, &count, sizeof(count)) < 0 && errno == EINTR)
+        ;
+}
+
+/* Write the buffered records to the file. Only uses write, so it is safe
+ * in a signal handler.
+ */
+void journalWrite()
+{
+    size_t done = 0;
+    ssize_t n;
+
+    while (journal.fd >= 0 && done < journal.length)
     {
-        for (j = 0; j < board->size; j++)
-        {
-            moveCursor(PADDING_TOP + i + 1, PADDING_LEFT + 2 * (j + 1));
-            switch (board->cells[i][j])
-            {
-            case BLUE:
-                printf(COLOR_BLUE "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case GREEN:
-                printf(COLOR_GREEN "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case YELLOW:
-                printf(COLOR_YELLOW "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case ORANGE:
-                printf(COLOR_ORANGE "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case RED:
-                printf(COLOR_RED "%c " COLOR_RESET, board->cells[i][j]);
-                break;
-            case EMPTY:
-                printf("%c ", board->cells[i][j]);
-                break;
-            }
-        }
+        n = write(journal.fd, journal.buffer + done, journal.length - done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        done += n;
     }
+    journal.length = 0;
 }
 
-void render(Board *board, Player *player1, Player *player2)
+/* Hold back the signals journalSignal handles while the game thread
+ * changes the buffer, which the handler writes out.
+ */
+void journalBlockSignals(sigset_t *old)
 {
-    int i;
-    clearScreen();
-    renderBoard(board);
-
-    moveCursor(PADDING_TOP, PADDING_LEFT + 2 * board->size + 5);
-    printf("%-10s| Score |", "Player");
-    printf(COLOR_BLUE " A " COLOR_RESET);
-    printf(COLOR_GREEN " B " COLOR_RESET);
-    printf(COLOR_YELLOW " C " COLOR_RESET);
-    printf(COLOR_ORANGE " D " COLOR_RESET);
-    printf(COLOR_RED " E " COLOR_RESET);
-
-    moveCursor(PADDING_TOP + 1, PADDING_LEFT + 2 * board->size + 5);
-    printf("%-10s| %5d | ", player1->name, player1->score);
-    for (i = 0; i < 5; i++)
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTERM);
+    sigaddset(&set, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &set, old);
+}
+
+void journalRestoreSignals(sigset_t *old)
+{
+    pthread_sigmask(SIG_SETMASK, old, NULL);
+}
+
+void journalAppend(const char *text, int length)
+{
+    if (JOURNAL_BUFFER - journal.length < (size_t)length)
+        journalWrite();
+    memcpy(journal.buffer + journal.length, text, length);
+    journal.length += length;
+}
+
+/* A turn ended, write the journal as the sync mode asks */
+void journalTurn()
+{
+    journal.turns++;
+    if (journal.sync == SYNC_TURN || (journal.sync == SYNC_EVERY && journal.turns % journal.every == 0))
+        journalWrite();
+}
+
+/* Put a record into the ring, waiting while the writer is behind */
+void ringPush(RecordKind kind, const char *text, int length)
+{
+    JournalRing *ring = journal.ring;
+    size_t head = ring->head;
+    RingSlot *slot;
+
+    while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= RING_SLOTS)
     {
-        printf("%-2d ", player1->pieces[i]);
+        __atomic_store_n(&ring->gameWaiting, 1, __ATOMIC_SEQ_CST);
+        if (head - __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) >= RING_SLOTS)
+            ringBlock(ring->wakeGame);
+        __atomic_store_n(&ring->gameWaiting, 0, __ATOMIC_RELAXED);
     }
+    slot = &ring->slots[head % RING_SLOTS];
+    slot->kind = kind;
+    slot->length = length;
+    if (length > 0)
+        memcpy(slot->text, text, length);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->writerWaiting, __ATOMIC_SEQ_CST))
+        ringNotify(ring->wakeWriter);
+}
 
-    moveCursor(PADDING_TOP + 2, PADDING_LEFT + 2 * board->size + 5);
-    printf("%-10s| %5d | ", player2->name, player2->score);
-    for (i = 0; i < 5; i++)
+/* Writer thread: apply the records of the ring until it is asked to
+ * stop and the ring is empty, then write what is left.
+ */
+void *journalWriter(void *arg)
+{
+    JournalRing *ring = (JournalRing *)arg;
+    size_t tail = ring->tail;
+    RingSlot *slot;
+    sigset_t all;
+
+    /* signals are handled by the game thread */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+
+    for (;;)
     {
-        printf("%-2d ", player2->pieces[i]);
+        if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+        {
+            if (__atomic_load_n(&ring->stop, __ATOMIC_ACQUIRE) && tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+                break;
+            __atomic_store_n(&ring->writerWaiting, 1, __ATOMIC_SEQ_CST);
+            if (tail == __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) && !__atomic_load_n(&ring->stop, __ATOMIC_SEQ_CST))
+                ringBlock(ring->wakeWriter);
+            __atomic_store_n(&ring->writerWaiting, 0, __ATOMIC_RELAXED);
+            continue;
+        }
+        slot = &ring->slots[tail % RING_SLOTS];
+        if (slot->kind == RECORD_TURN)
+            journalTurn();
+        else
+            journalAppend(slot->text, slot->length);
+        __atomic_store_n(&ring->tail, ++tail, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->gameWaiting, __ATOMIC_SEQ_CST))
+            ringNotify(ring->wakeGame);
     }
+    journalWrite();
+    __atomic_store_n(&ring->done, 1, __ATOMIC_RELEASE);
+    ringNotify(ring->finished);
+    return NULL;
 }
 
-/* Move a piece on the board according to the given move.
- *
- * Parameters:
- *     board: pointer to the Board structure containing the game board.
- *     move: pointer to the Move structure detailing the move to be made.
- */
-void movePiece(Board *board, Move *move)
+/* Drain the ring and wait for the writer thread to finish */
+void journalStopWriter()
 {
-    if (move == NULL)
+    JournalRing *ring = journal.ring;
+
+    if (!journal.writing)
         return;
+    __atomic_store_n(&ring->stop, 1, __ATOMIC_SEQ_CST);
+    ringNotify(ring->wakeWriter);
+    pthread_join(journal.writer, NULL);
+    close(ring->wakeWriter);
+    close(ring->wakeGame);
+    close(ring->finished);
+    journal.writing = 0;
+}
 
-    int toBottom = move->direction == DOWN ? +2 : move->direction == UP ? -2 : 0;
-    int toRight = move->direction == RIGHT ? +2 : move->direction == LEFT ? -2 : 0;
+/* Write, fsync and close the journal */
+void journalClose()
+{
+    sigset_t old;
 
-    board->cells[move->PieceX + toBottom][move->PieceY + toRight] = board->cells[move->PieceX][move->PieceY];
-    board->cells[move->PieceX][move->PieceY] = EMPTY;
+    if (journal.fd < 0)
+        return;
+    journalBlockSignals(&old);
+    journalStopWriter();
+    journalWrite();
+    fsync(journal.fd);
+    close(journal.fd);
+    journal.fd = -1;
+    journal.turns = 0;
+    journalRestoreSignals(&old);
+}
 
-    toRight /= 2;
-    toBottom /= 2;
+void journalSignal(int sig)
+{
+    struct pollfd finished;
+    int i;
 
-    board->cells[move->PieceX + toBottom][move->PieceY + toRight] = EMPTY;
-    return movePiece(board, move->next);
+    if (journal.fd >= 0)
+    {
+        if (journal.writing)
+        {
+            /* the writer drains the ring, give it RING_DRAIN_MS */
+            __atomic_store_n(&journal.ring->stop, 1, __ATOMIC_SEQ_CST);
+            ringNotify(journal.ring->wakeWriter);
+            finished.fd = journal.ring->finished;
+            finished.events = POLLIN;
+            for (i = 0; i < 10 && !__atomic_load_n(&journal.ring->done, __ATOMIC_ACQUIRE); i++)
+                poll(&finished, 1, RING_DRAIN_MS / 10);
+        }
+        else
+        {
+            journalWrite();
+        }
+        fsync(journal.fd);
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
 }
 
-/* Check if a next move is available from the current move position.
- *
- * Parameters:
- *     board: pointer to the Board structure containing the game board.
- *     move: pointer to the Move structure containing the current move position.
+/* Make the journal point to the given file, opening it if it is not the
+ * open one. With truncate the file is emptied first.
  *
  * Returns:
- *     1 if a next move is available, 0 otherwise.
+ *     0 on success, -1 if the file cannot be opened.
  */
-int isNextMoveAvailable(Board *board, Move *move)
+int journalOpen(char *filename, int truncate)
 {
-    /* check if can move right */ 
-    if (
-            board->size > move->PieceX + 2 &&
-            move->PieceX + 2 >= 0 &&
-            board->cells[move->PieceX + 1][move->PieceY] != EMPTY &&
-            board->cells[move->PieceX + 2][move->PieceY] == EMPTY
-        )
-    {
-        return 1;
-    }
+    struct sigaction action;
+    unsigned char header[BINARY_HEADER];
 
-    /* check if can move left */
-    if (
-            board->size > move->PieceX - 2 &&
-            move->PieceX - 2 >= 0 &&
-            board->cells[move->PieceX - 1][move->PieceY] != EMPTY && 
-            board->cells[move->PieceX - 2][move->PieceY] == EMPTY
-        )
+    if (journal.fd >= 0 && !truncate && strcmp(journal.path, filename) == 0)
+        return 0;
+    journalClose();
+    journal.fd = open(filename, O_RDWR | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    if (journal.fd < 0)
+        return -1;
+    strncpy(journal.path, filename, sizeof(journal.path) - 1);
+    journal.path[sizeof(journal.path) - 1] = '\0';
+
+    /* moves appended to a binary save must be binary too */
+    journal.binary = 0;
+    if (!truncate && pread(journal.fd, header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+        memcmp(header, BINARY_MAGIC, 4) == 0)
     {
-        return 1;
+        journal.binary = 1;
+        journal.binarySize = header[5];
+        journal.binaryVersion = header[4];
     }
 
-    /* check if can move up */
-    if (
-            board->size > move->PieceY - 2 &&
-            move->PieceY - 2 >= 0 &&
-            board->cells[move->PieceX][move->PieceY - 1] != EMPTY &&
-            board->cells[move->PieceX][move->PieceY - 2] == EMPTY
-        )
-
+    if (!journal.handlers)
     {
-        return 1;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = journalSignal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        sigaction(SIGHUP, &action, NULL);
+        atexit(journalClose);
+        journal.handlers = 1;
     }
 
-    /* check if can move down */ 
-    if (
-            board->size > move->PieceY + 2 &&
-            move->PieceY + 2 >= 0 &&
-            board->cells[move->PieceX][move->PieceY + 1] != EMPTY &&
-            board->cells[move->PieceX][move->PieceY + 2] == EMPTY
-        )
+    if (journal.async)
     {
-        return 1;
+        if (journal.ring == NULL)
+            journal.ring = (JournalRing *)malloc(sizeof(JournalRing));
+        journal.ring->head = journal.ring->tail = 0;
+        journal.ring->stop = journal.ring->done = 0;
+        journal.ring->writerWaiting = journal.ring->gameWaiting = 0;
+        journal.ring->wakeWriter = eventfd(0, EFD_CLOEXEC);
+        journal.ring->wakeGame = eventfd(0, EFD_CLOEXEC);
+        journal.ring->finished = eventfd(0, EFD_CLOEXEC);
+        journal.writing = journal.ring->wakeWriter >= 0 && journal.ring->wakeGame >= 0 &&
+                          journal.ring->finished >= 0 &&
+                          pthread_create(&journal.writer, NULL, journalWriter, journal.ring) == 0;
+        if (!journal.writing)
+        {
+            /* records are written by the game thread instead */
+            if (journal.ring->wakeWriter >= 0)
+                close(journal.ring->wakeWriter);
+            if (journal.ring->wakeGame >= 0)
+                close(journal.ring->wakeGame);
+            if (journal.ring->finished >= 0)
+                close(journal.ring->finished);
+        }
     }
-
     return 0;
 }
 
-/* Get the direction from user input.
- *
- * Parameters:
- *     board: pointer to the Board structure used for error printing if needed.
- *
- * Returns:
- *     The direction entered by the user as a Direction enum value.
- *     Returns -1 if the input is 'x'.
- */
-Direction getDirection(Board *board)
+/* Append raw bytes to the journal, which must be open */
+void journalData(const char *data, int length)
 {
-    char direction;
+    sigset_t old;
 
-    scanf(" %c", &direction);
-    if (direction == 'x')
+    if (journal.writing)
     {
-        return NO_DIRECTION;
+        ringPush(RECORD_TEXT, data, length);
+        return;
     }
-    if (direction > 'A')
+    journalBlockSignals(&old);
+    journalAppend(data, length);
+    journalRestoreSignals(&old);
+}
+
+/* Append one record to the journal of the file */
+void journalRecord(char *filename, int truncate, const char *format, ...)
+{
+    char record[JOURNAL_RECORD];
+    va_list args;
+    int n;
+
+    if (journalOpen(filename, truncate) != 0)
     {
-        direction -= 'a' - 'A';
+        printf("File not found\n");
+        exit(1);
     }
+    va_start(args, format);
+    n = vsnprintf(record, JOURNAL_RECORD, format, args);
+    va_end(args);
+    if (n >= JOURNAL_RECORD)
+        n = JOURNAL_RECORD - 1;
+    if (n > 0)
+        journalData(record, n);
+}
 
-    switch (direction)
+/* Called after every turn */
+void journalEndTurn()
+{
+    sigset_t old;
+
+    if (journal.fd < 0)
+        return;
+    if (journal.writing)
     {
-    case 'W':
-        return UP;
-        break;
-    case 'S':
-        return DOWN;
-        break;
-    case 'A':
-        return LEFT;
-        break;
-    case 'D':
-        return RIGHT;
-        break;
-    default:
-        printError(board, "Invalid direction\n");
-        return getDirection(board);
+        ringPush(RECORD_TURN, NULL, 0);
+        return;
     }
-    return -1;
+    journalBlockSignals(&old);
+    journalTurn();
+    journalRestoreSignals(&old);
 }
 
-/* Undo a move on the board and restore the taken piece.
+/* Save player to file. This will append to the file
  *
  * Parameters:
- *     board: pointer to the Board structure containing the game board.
- *     move: pointer to the Move structure detailing the move to be undone.
- *     taken: the piece that was taken during the move.
+ *     filename: name of the file to be written.
+ *     player: pointer to the player struct to be saved.
  */
-void undoMove(Board *board, Move *move, Piece taken)
+void savePlayer(char *filename, Player *player)
 {
-    int toBottom = move->direction == DOWN ? +2 : move->direction == UP ? -2 : 0;
-    int toRight = move->direction == RIGHT ? +2 : move->direction == LEFT ? -2 : 0;
-
-    board->cells[move->PieceX][move->PieceY] = board->cells[move->PieceX + toBottom][move->PieceY + toRight];
-    board->cells[move->PieceX + toBottom][move->PieceY + toRight] = EMPTY;
-
-    toRight /= 2;
-    toBottom /= 2;
-
-    board->cells[move->PieceX + toBottom][move->PieceY + toRight] = taken;
+    journalRecord(filename, 0, "player: id: %d, type: %d, name: %s\n", player->id, player->type, player->name);
 }
 
-int humanMakeMove(Board *board, Player *player, Player *Opponent, char *outfile)
+/* Load player from file with given id.
+ *
+ * Parameters:
+ *     filename: name of the file which player is located.
+ *     playerId: Id of the player
+ */
+Player *loadPlayer(char *filename, int playerId)
 {
-    char xaxis, yaxis;
-    int x, y;
-    Move *move;
-    Move last;
-    int nextMoveAvailable = 1;
-    int score, i, j;
-    int redoAvailable = 1;
-    int moveAvailable = 0;
+    FILE *file;
+    Player *player;
+    char name[100];
+    int id, type;
+    file = fopen(filename , "r");
+    char line[100];
+    if (file == NULL)
+    {
+        printf("File not found\n");
+        exit(1);
+    }
+    player = (Player *)malloc(sizeof(Player));
+    player->search = NULL;
+    player->score = 0;
+    memset(player->pieces, 0, sizeof(player->pieces));
 
-    /* check if any move available */ 
-    Move *dummy = createMove(0, 0, 0);
-    for (i = 0; i < board->size; i++)
+    while (fgets(line, 100, file) != NULL)
     {
-        for (j = 0; j < board->size; j++)
+        if (sscanf(line, "player: id: %d, type: %d, name: %s", &id, &type, name) == 3)
         {
-            if (board->cells[i][j] != EMPTY)
+            if (id == playerId)
             {
-                dummy->PieceX = i;
-                dummy->PieceY = j;
-                if (isNextMoveAvailable(board, dummy))
-                {
-                    moveAvailable = 1;
-                }
+                player->id = id;
+                player->type = type;
+                strncpy(player->name, name, 50);
             }
         }
     }
-    free(dummy);
-    if (moveAvailable == 0)
-    {
-        printError(board, "No move available\n");
+
+    fclose(file);
+    return player;
+}
+
+/* Save the player's move to a file.
+ *
+ * Parameters:
+ *     filename: name of the file where the move will be saved.
+ *     player: pointer to the Player structure containing player details.
+ *     move: the move to be saved.
+ */
+void saveMove(char *filename, Move move)
+{
+    char word[BINARY_MOVE];
+    unsigned value;
+
+    if (journalOpen(filename, 0) == 0 && journal.binary)
+    {
+        value = (move.PieceX * journal.binarySize + move.PieceY) | (unsigned)move.direction << 9 | (unsigned)(move.playerId - 1) << 11;
+        word[0] = value & 0xff;
+        word[1] = value >> 8;
+        journalData(word, BINARY_MOVE);
+        return;
+    }
+    journalRecord(filename, 0, "move: player: %d, x: %d, y: %d, direction: %d\n", move.playerId, move.PieceX, move.PieceY, move.direction);
+}
+
+/* Save a checkpoint record of a board of the given size to a file */
+void saveCheckpointRecord(char *filename, int size, const Checkpoint *checkpoint)
+{
+    unsigned char data[CHECKPOINT_BYTES(MAX_BOARD_SIZE)];
+    char cells[MAX_CELLS + 1];
+    const int *p = &checkpoint->pieces[0][0];
+    int i;
+
+    if (journalOpen(filename, 0) == 0 && journal.binary)
+    {
+        /* version 1 has no checkpoints, its readers would take the
+         * record for moves; the game still loads by replaying them
+         */
+        if (journal.binaryVersion < 2)
+            return;
+        memset(data, 0, sizeof(data));
+        encodeCheckpoint(data, size, checkpoint);
+        journalData((char *)data, CHECKPOINT_BYTES(size));
+        return;
+    }
+    for (i = 0; i < size * size; i++)
+        cells[i] = checkpoint->cells[i] == EMPTY ? '.' : checkpoint->cells[i];
+    cells[i] = '\0';
+    journalRecord(filename, 0, "checkpoint: next: %d, score: %d %d, pieces: %d %d %d %d %d %d %d %d %d %d, board: %s\n",
+                  checkpoint->next, checkpoint->score[0], checkpoint->score[1],
+                  p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8], p[9], cells);
+}
+
+/* Save a checkpoint of the board and the players to a file.
+ *
+ * Parameters:
+ *     next: id of the player to move.
+ */
+void saveCheckpoint(char *filename, Board *board, Player *player1, Player *player2, int next)
+{
+    Checkpoint checkpoint;
+    int i, j;
+
+    checkpoint.next = next;
+    checkpoint.score[0] = player1->score;
+    checkpoint.score[1] = player2->score;
+    memcpy(checkpoint.pieces[0], player1->pieces, sizeof(checkpoint.pieces[0]));
+    memcpy(checkpoint.pieces[1], player2->pieces, sizeof(checkpoint.pieces[1]));
+    for (i = 0; i < board->size; i++)
+        for (j = 0; j < board->size; j++)
+            checkpoint.cells[i * board->size + j] = board->cells[i][j];
+    saveCheckpointRecord(filename, board->size, &checkpoint);
+}
+
+/* Load the game board from a file.
+ *
+ * Parameters:
+ *     filename: name of the file which contains the board data.
+ *
+ * Returns:
+ *     A pointer to the Board structure with the loaded data.
+ */
+Board* loadBoard(char *filename)
+{
+    FILE *file;
+    Board *board;
+    int i, j, N;
+    char c;
+    file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        printf("File not found\n");
+        exit(1);
+    }
+    fscanf(file, "size: %d\n", &N);
+    fscanf(file, "board:\n");
+    if (N < 4 || N > MAX_BOARD_SIZE)
+    {
+        printf("Invalid board size\n");
+        exit(1);
+    }
+    board = allocBoard(N);
+    for (i = 0; i < board->size; i++)
+    {
+        for (j = 0; j < board->size; j++)
+        {
+            fscanf(file, "%c", &c);
+            if (c < 'A' || c > 'E')
+            {
+                c = EMPTY;
+            }
+            setCell(board, i, j, c);
+        }
+        fscanf(file, "\n");
+    }
+    fclose(file);
+    computeBoardHash(board);
+    return board;
+}
+
+/* Initialize a game board with given size N.
+ *
+ * Parameters:
+ *     N: the size of the board (N x N).
+ *
+ * Returns:
+ *     A pointer to the initialized Board structure with size N x N.
+ */
+Board *initBoard(int N)
+{
+    int i, j, random;
+    Piece p;
+    Board *board;
+    if (N % 2 != 0)
+    {
+        printf("Board size must be an even number\n");
+        return NULL;
+    }
+
+    board = allocBoard(N);
+    for (i = 0; i < N; i++)
+    {
+        for (j = 0; j < N; j++)
+        {
+            /* check if the cell is in the middle */
+            if ( (i == N/2-1 || i == N/2) && (j == N/2-1 || j == N/2) )
+            {
+                setCell(board, i, j, EMPTY);
+            }
+            else 
+            {
+                random = rand() % 5;
+                p = 'A' + random;
+                setCell(board, i, j, p);
+            }
+        }
+    }
+
+    computeBoardHash(board);
+    return board;
+}
+
+/* Initialize a game board like initBoard, with pieces drawn from a
+ * private generator so boards can be made from a seed on any thread.
+ *
+ * Parameters:
+ *     N: the size of the board (N x N).
+ *     seed: the seed of the board.
+ */
+Board *initBoardSeeded(int N, uint64_t seed)
+{
+    int i, j;
+    Board *board;
+    uint64_t state = seed;
+    if (N % 2 != 0)
+    {
+        return NULL;
+    }
+
+    board = allocBoard(N);
+    for (i = 0; i < N; i++)
+    {
+        for (j = 0; j < N; j++)
+        {
+            /* the middle four cells stay empty */
+            if ( (i == N/2-1 || i == N/2) && (j == N/2-1 || j == N/2) )
+                setCell(board, i, j, EMPTY);
+            else
+                setCell(board, i, j, 'A' + (int)(splitmix64(&state) % 5));
+        }
+    }
+
+    computeBoardHash(board);
+    return board;
+}
+
+/* Save the game board to a file.
+ *
+ * Parameters:
+ *     board: pointer to the Board structure containing the board data.
+ *     filename: name of the file where the board will be saved.
+ */
+void saveBoard(Board *board, char *filename)
+{
+    char row[MAX_BOARD_SIZE + 2];
+    int i, j;
+    /* a new save file */
+    journalRecord(filename, 1, "size: %d\n", board->size);
+    journalRecord(filename, 0, "board:\n");
+    for (i = 0; i < board->size; i++)
+    {
+        for (j = 0; j < board->size; j++)
+        {
+            row[j] = board->cells[i][j];
+        }
+        row[j] = '\0';
+        journalRecord(filename, 0, "%s\n", row);
+    }
+}
+
+/* Create a new move with specified coordinates and direction.
+ *
+ * Parameters:
+ *     x: the x-coordinate of the move.
+ *     y: the y-coordinate of the move.
+ *     direction: the direction of the move.
+ *
+ * Returns:
+ *     A pointer to the newly created Move structure.
+ */
+Move *createMove(int x, int y, Direction direction)
+{
+    Move *move = (Move *)malloc(sizeof(Move));
+    move->PieceX = x;
+    move->PieceY = y;
+    move->direction = direction;
+    move->next = NULL;
+    move->playerId = 0;
+    return move;
+}
+
+/* Free the memory allocated for the game board.
+ *
+ * Parameters:
+ *     board: pointer to the Board structure to be freed.
+ */
+void freeBoard(Board *board)
+{
+    free(board->cells[0]);
+    free(board->cells);
+    free(board);
+}
+
+/* Update the player's score based on the pieces they have.
+ *
+ * Parameters:
+ *     p1: pointer to the Player structure whose score will be updated.
+ */
+void loadScores(Player *p1)
+{
+    int scoreAvail = 1;
+    int i;
+    while (scoreAvail)
+    {
+        for (i = 0; i < 5; i++)
+        {
+            if (p1->pieces[i] == 0)
+            {
+                scoreAvail = 0;
+            }
+        }
+
+        if (scoreAvail)
+        {
+            p1->score++;
+            for (i = 0; i < 5; i++)
+            {
+                p1->pieces[i]--;
+            }
+        }
+    }
+}
+
+/* Add a taken piece to the player and complete a set of A-E if possible.
+ *
+ * Returns:
+ *     1 if a set was completed and the score increased, 0 otherwise.
+ */
+int takePiece(Player *player, Piece c)
+{
+    int i;
+    player->pieces[c - 'A']++;
+    for (i = 0; i < 5; i++)
+    {
+        if (player->pieces[i] == 0)
+        {
+            return 0;
+        }
+    }
+    player->score++;
+    for (i = 0; i < 5; i++)
+    {
+        player->pieces[i]--;
+    }
+    return 1;
+}
+
+void renderBoard(Board *board);
+void movePiece(Board *board, Move *move);
+/* Play the moves of a save file starting at a byte offset.
+ *
+ * Parameters:
+ *     lastPlayerId: the player to move at the offset, replaced by the
+ *         player to move after the last move.
+ */
+void loadMovesFrom(char *filename, long offset, Board *board, Player *player1, Player *player2, int* lastPlayerId)
+{
+    FILE *file;
+    Move *move = createMove(0, 0, 0);
+    char line[100];
+    int x, y, direction, playerId;
+    file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        printf("File not found\n");
+        exit(1);
+    }
+    int lastId = *lastPlayerId == 1 ? 2 : 1;
+    fseek(file, offset, SEEK_SET);
+    while (fgets(line, 100, file) != NULL)
+    {
+        if (sscanf(line, "move: player: %d, x: %d, y: %d, direction: %d", &playerId, &x, &y, &direction) == 4)
+        {
+            move->PieceX = x;
+            move->PieceY = y;
+            move->direction = direction;
+            move->playerId = playerId;
+            move->next = NULL;
+            Piece c = isMoveValid(board, move);
+            movePiece(board, move);
+            if (c == INVALID_PIECE)
+            {
+                renderBoard(board);
+                printError(board, "Invalid move, x: %d, y: %d, direction: %d\n", x, y, direction);
+                exit(1);
+            }
+            /* give point to accourding player */
+            if (player1->id == playerId)
+            {
+                player1->pieces[c - 'A']++;
+            }
+            else if (player2->id == playerId)
+            {
+                player2->pieces[c - 'A']++;
+            }
+            lastId = playerId;
+        }
+    }
+    if (lastId == 2)
+        *lastPlayerId = 1;
+    else
+        *lastPlayerId = 2;
+    fclose(file);
+}
+
+void loadMoves(char *filename, Board *board, Player *player1, Player *player2, int* lastPlayerId)
+{
+    *lastPlayerId = 1;
+    loadMovesFrom(filename, 0, board, player1, player2, lastPlayerId);
+}
+
+/* Find the last checkpoint of a text save file. Only the last `limit`
+ * bytes are searched, backwards in chunks, so a file without a recent
+ * checkpoint is not read twice.
+ *
+ * Returns:
+ *     The offset of the checkpoint line, -1 if there is none.
+ */
+long findLastCheckpoint(int fd, long limit)
+{
+    char chunk[4096];
+    const char *tag = "\ncheckpoint: ";
+    long end, start, found = -1, stop;
+    size_t tagLength = strlen(tag), i;
+    ssize_t n;
+
+    end = lseek(fd, 0, SEEK_END);
+    stop = end > limit ? end - limit : 0;
+    while (found < 0 && end > stop)
+    {
+        start = end - stop > (long)sizeof(chunk) ? end - (long)sizeof(chunk) : stop;
+        n = pread(fd, chunk, end - start, start);
+        if (n <= 0)
+            break;
+        for (i = n; found < 0 && i >= tagLength; i--)
+        {
+            if (chunk[i - tagLength] == '\n' && chunk[i - tagLength + 1] == 'c' &&
+                memcmp(chunk + i - tagLength, tag, tagLength) == 0)
+                found = start + (long)(i - tagLength) + 1;
+        }
+        /* chunks overlap so a tag across their border is found too */
+        end = start > stop ? start + (long)tagLength - 1 : stop;
+    }
+    lseek(fd, 0, SEEK_SET);
+    return found;
+}
+
+/* Check that the line at `offset` of a text save is a whole checkpoint
+ * of a board of the given size; the last one may be cut short by a
+ * crash.
+ */
+int isCheckpointAt(int fd, long offset, int size)
+{
+    char line[JOURNAL_RECORD];
+    Checkpoint checkpoint;
+    ssize_t n = pread(fd, line, sizeof(line) - 1, offset);
+    char *end;
+
+    if (n <= 0)
+        return 0;
+    line[n] = '\0';
+    end = strchr(line, '\n');
+    if (end != NULL)
+        *end = '\0';
+    return parseCheckpoint(line, size, &checkpoint);
+}
+
+/* Print the board */
+void printBoard(Board *board)
+{
+    int i, j;
+    for (i = 0; i < board->size; i++)
+    {
+        for (j = 0; j < board->size; j++)
+        {
+            switch (board->cells[i][j])
+            {
+            case BLUE:
+                printf(COLOR_BLUE "%c " COLOR_RESET, board->cells[i][j]);
+                break;
+            case GREEN:
+                printf(COLOR_GREEN "%c " COLOR_RESET, board->cells[i][j]);
+                break;
+            case YELLOW:
+                printf(COLOR_YELLOW "%c " COLOR_RESET, board->cells[i][j]);
+                break;
+            case ORANGE:
+                printf(COLOR_ORANGE "%c " COLOR_RESET, board->cells[i][j]);
+                break;
+            case RED:
+                printf(COLOR_RED "%c " COLOR_RESET, board->cells[i][j]);
+                break;
+            case EMPTY:
+                printf("%c ", board->cells[i][j]);
+                break;
+            }
+        }
+        printf("\n");
+    }
+}
+
+/* Print the piece on a cell in its colour */
+void drawCell(Board *board, int i, int j)
+{
+    moveCursor(PADDING_TOP + i + 1, PADDING_LEFT + 2 * (j + 1));
+    switch (board->cells[i][j])
+    {
+    case BLUE:
+        framePrintf(COLOR_BLUE "%c " COLOR_RESET, board->cells[i][j]);
+        break;
+    case GREEN:
+        framePrintf(COLOR_GREEN "%c " COLOR_RESET, board->cells[i][j]);
+        break;
+    case YELLOW:
+        framePrintf(COLOR_YELLOW "%c " COLOR_RESET, board->cells[i][j]);
+        break;
+    case ORANGE:
+        framePrintf(COLOR_ORANGE "%c " COLOR_RESET, board->cells[i][j]);
+        break;
+    case RED:
+        framePrintf(COLOR_RED "%c " COLOR_RESET, board->cells[i][j]);
+        break;
+    case EMPTY:
+        framePrintf("%c ", board->cells[i][j]);
+        break;
+    }
+}
+
+void whitePiece(Board *board, int x, int y)
+{
+    frameBegin();
+    moveCursor(PADDING_TOP + x + 1, PADDING_LEFT + 2 * (y + 1));
+    framePrintf(COLOR_WHITE "\033[1m%c " COLOR_RESET, board->cells[x][y]);
+    /* the cell no longer shows its colour, repaint it next time */
+    screen.cells[x * board->size + y] = SCREEN_DIRTY;
+    frameEnd();
+}
+
+/* Draw the board. The axes are drawn with the first frame, after that
+ * only the cells that differ from the shadow copy are repainted.
+ */
+void renderBoard(Board *board)
+{
+    int i, j;
+
+    frameBegin();
+    if (!screen.valid || screen.size != board->size)
+    {
+        moveCursor(PADDING_TOP, PADDING_LEFT);
+        for (i = 0; i <= board->size; i++)
+        {
+            if (i < 10)
+            {
+                framePrintf(COLOR_BOLD "%d " RESET, i);
+            }
+            else
+            {
+                framePrintf(COLOR_BOLD "%c " RESET, 'A' + i - 10);
+            }
+        }
+
+        for (i = 1; i <= board->size; i++)
+        {
+            moveCursor(PADDING_TOP + i, PADDING_LEFT);
+            if (i < 10)
+            {
+                framePrintf(COLOR_BOLD "%d " RESET, i);
+            }
+            else
+            {
+                framePrintf(COLOR_BOLD "%c " RESET, 'A' + i - 10);
+            }
+        }
+
+        for (i = 0; i < board->size * board->size; i++)
+        {
+            screen.cells[i] = SCREEN_DIRTY;
+        }
+        screen.size = board->size;
+        screen.valid = 1;
+    }
+
+    for (i = 0; i < board->size; i++)
+    {
+        for (j = 0; j < board->size; j++)
+        {
+            if (screen.cells[i * board->size + j] != board->cells[i][j])
+            {
+                drawCell(board, i, j);
+                screen.cells[i * board->size + j] = board->cells[i][j];
+            }
+        }
+    }
+    frameEnd();
+}
+
+/* Columns a UTF-8 string takes on the terminal, one per character */
+int displayWidth(const char *text)
+{
+    int width = 0;
+    for (; *text; text++)
+    {
+        if ((*text & 0xC0) != 0x80)
+            width++;
+    }
+    return width;
+}
+
+/* Repaint a score table row from its first changed entry on */
+void renderScoreRow(Board *board, Player *player, int row)
+{
+    char entries[6][16];
+    int column = PADDING_LEFT + 2 * board->size + 5 + displayWidth(screen.names[row]);
+    int i, first = -1;
+
+    sprintf(entries[0], "%5d | ", player->score);
+    for (i = 0; i < 5; i++)
+    {
+        sprintf(entries[i + 1], "%-2d ", player->pieces[i]);
+    }
+    for (i = 0; i < 6; i++)
+    {
+        if (first < 0 && strcmp(entries[i], screen.entries[row][i]) != 0)
+            first = i;
+        if (first < 0)
+            column += (int)strlen(entries[i]);
+    }
+    if (first < 0)
+        return;
+
+    moveCursor(PADDING_TOP + 1 + row, column);
+    for (i = first; i < 6; i++)
+    {
+        framePrintf("%s", entries[i]);
+        strcpy(screen.entries[row][i], entries[i]);
+    }
+    clearToEnd();
+}
+
+/* Render the game. The first frame clears the screen and draws
+ * everything, later frames only repaint what changed since the last one
+ * and clear the message lines that were written in between. The whole
+ * update goes out as one frame.
+ */
+void render(Board *board, Player *player1, Player *player2)
+{
+    int i;
+    char line[128];
+
+    frameBegin();
+    if (!screen.valid || screen.size != board->size)
+    {
+        clearScreen();
+        screen.valid = 0;
+        renderBoard(board);
+
+        moveCursor(PADDING_TOP, PADDING_LEFT + 2 * board->size + 5);
+        framePrintf("%-10s| Score |", "Player");
+        framePrintf(COLOR_BLUE " A " COLOR_RESET);
+        framePrintf(COLOR_GREEN " B " COLOR_RESET);
+        framePrintf(COLOR_YELLOW " C " COLOR_RESET);
+        framePrintf(COLOR_ORANGE " D " COLOR_RESET);
+        framePrintf(COLOR_RED " E " COLOR_RESET);
+
+        sprintf(screen.names[0], "%.49s", player1->name);
+        sprintf(screen.names[1], "%.49s", player2->name);
+        for (i = 0; i < 2; i++)
+        {
+            /* pad to 10 columns, not bytes, for names outside ASCII */
+            while (displayWidth(screen.names[i]) < 10)
+                strcat(screen.names[i], " ");
+            strcat(screen.names[i], "| ");
+            moveCursor(PADDING_TOP + 1 + i, PADDING_LEFT + 2 * board->size + 5);
+            framePrintf("%s", screen.names[i]);
+            memset(screen.entries[i], 0, sizeof(screen.entries[i]));
+        }
+        screen.search[0] = '\0';
+        screen.messages = 0;
+    }
+    else
+    {
+        renderBoard(board);
+        if (screen.messages & SCREEN_CONTROL)
+        {
+            moveCursor(PADDING_TOP + 4, PADDING_LEFT + 2 * board->size + 5);
+            clearToEnd();
+        }
+        clearErrorLines(board);
+        screen.messages = 0;
+    }
+
+    renderScoreRow(board, player1, 0);
+    renderScoreRow(board, player2, 1);
+
+    /* report of the last alpha-beta search */
+    if (lastSearch.depth > 0)
+    {
+        sprintf(line, "Search: depth %d, %lu nodes, %lu ms", lastSearch.depth, lastSearch.nodes, (unsigned long)lastSearch.elapsedMs);
+        if (strcmp(line, screen.search) != 0)
+        {
+            moveCursor(PADDING_TOP + 3, PADDING_LEFT + 2 * board->size + 5);
+            framePrintf("%s", line);
+            clearToEnd();
+            strcpy(screen.search, line);
+        }
+    }
+    frameEnd();
+}
+
+/* Move a piece on the board according to the given move.
+ *
+ * Parameters:
+ *     board: pointer to the Board structure containing the game board.
+ *     move: pointer to the Move structure detailing the move to be made.
+ */
+void movePiece(Board *board, Move *move)
+{
+    if (move == NULL)
+        return;
+
+    int toBottom = move->direction == DOWN ? +2 : move->direction == UP ? -2 : 0;
+    int toRight = move->direction == RIGHT ? +2 : move->direction == LEFT ? -2 : 0;
+
+    setCell(board, move->PieceX + toBottom, move->PieceY + toRight, board->cells[move->PieceX][move->PieceY]);
+    setCell(board, move->PieceX, move->PieceY, EMPTY);
+
+    toRight /= 2;
+    toBottom /= 2;
+
+    setCell(board, move->PieceX + toBottom, move->PieceY + toRight, EMPTY);
+    return movePiece(board, move->next);
+}
+
+/* Check if a next move is available from the current move position.
+ *
+ * Parameters:
+ *     board: pointer to the Board structure containing the game board.
+ *     move: pointer to the Move structure containing the current move position.
+ *
+ * Returns:
+ *     1 if a next move is available, 0 otherwise.
+ */
+int isNextMoveAvailable(Board *board, Move *move)
+{
+    /* check if can move right */ 
+    if (
+            board->size > move->PieceX + 2 &&
+            move->PieceX + 2 >= 0 &&
+            isCellOccupied(board, move->PieceX + 1, move->PieceY) &&
+            !isCellOccupied(board, move->PieceX + 2, move->PieceY)
+        )
+    {
+        return 1;
+    }
+
+    /* check if can move left */
+    if (
+            board->size > move->PieceX - 2 &&
+            move->PieceX - 2 >= 0 &&
+            isCellOccupied(board, move->PieceX - 1, move->PieceY) && 
+            !isCellOccupied(board, move->PieceX - 2, move->PieceY)
+        )
+    {
+        return 1;
+    }
+
+    /* check if can move up */
+    if (
+            board->size > move->PieceY - 2 &&
+            move->PieceY - 2 >= 0 &&
+            isCellOccupied(board, move->PieceX, move->PieceY - 1) &&
+            !isCellOccupied(board, move->PieceX, move->PieceY - 2)
+        )
+
+    {
+        return 1;
+    }
+
+    /* check if can move down */ 
+    if (
+            board->size > move->PieceY + 2 &&
+            move->PieceY + 2 >= 0 &&
+            isCellOccupied(board, move->PieceX, move->PieceY + 1) &&
+            !isCellOccupied(board, move->PieceX, move->PieceY + 2)
+        )
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/* Get the direction from user input.
+ *
+ * Parameters:
+ *     board: pointer to the Board structure used for error printing if needed.
+ *
+ * Returns:
+ *     The direction entered by the user as a Direction enum value.
+ *     Returns -1 if the input is 'x'.
+ */
+Direction getDirection(Board *board)
+{
+    char direction;
+
+    scanf(" %c", &direction);
+    if (direction == 'x')
+    {
+        return NO_DIRECTION;
+    }
+    if (direction > 'A')
+    {
+        direction -= 'a' - 'A';
+    }
+
+    switch (direction)
+    {
+    case 'W':
+        return UP;
+        break;
+    case 'S':
+        return DOWN;
+        break;
+    case 'A':
+        return LEFT;
+        break;
+    case 'D':
+        return RIGHT;
+        break;
+    default:
+        printError(board, "Invalid direction\n");
+        return getDirection(board);
+    }
+    return -1;
+}
+
+/* Undo a move on the board and restore the taken piece.
+ *
+ * Parameters:
+ *     board: pointer to the Board structure containing the game board.
+ *     move: pointer to the Move structure detailing the move to be undone.
+ *     taken: the piece that was taken during the move.
+ */
+void undoMove(Board *board, Move *move, Piece taken)
+{
+    int toBottom = move->direction == DOWN ? +2 : move->direction == UP ? -2 : 0;
+    int toRight = move->direction == RIGHT ? +2 : move->direction == LEFT ? -2 : 0;
+
+    setCell(board, move->PieceX, move->PieceY, board->cells[move->PieceX + toBottom][move->PieceY + toRight]);
+    setCell(board, move->PieceX + toBottom, move->PieceY + toRight, EMPTY);
+
+    toRight /= 2;
+    toBottom /= 2;
+
+    setCell(board, move->PieceX + toBottom, move->PieceY + toRight, taken);
+}
+
+int humanMakeMove(Board *board, Player *player, Player *Opponent, char *outfile)
+{
+    char xaxis, yaxis;
+    int x, y;
+    Move *move;
+    Move last;
+    int nextMoveAvailable = 1;
+    int score, i;
+    int redoAvailable = 1;
+
+    /* check if any move available */ 
+    if (!anyJumpAvailable(board))
+    {
+        printError(board, "No move available\n");
+        return 0;
+    }
+
+    /* get coordinates */ 
+    printControl(board, COLOR_BOLD "%s" COLOR_RESET " make your move: ", player->name);
+    scanf(" %c", &xaxis);
+    if (xaxis == 'q')
+    {
+        return 0;
+    }
+    scanf(" %c", &yaxis);
+    if (xaxis > '0' && xaxis <= '9')
+    {
+        x = xaxis - '0' - 1;
+    }
+    else if (xaxis >= 'A' && xaxis <= 'Z')
+    {
+        x = xaxis - 'A' + 9;
+    }
+    else if (xaxis >= 'a' && xaxis <= 'z')
+    {
+        x = xaxis - 'a' + 9;
+    }
+
+    if (yaxis > '0' && yaxis <= '9')
+    {
+        y = yaxis - '0' - 1;
+    }
+    else if (yaxis >= 'A' && yaxis <= 'Z')
+    {
+        y = yaxis - 'A' + 9;
+    }
+    else if (yaxis >= 'a' && yaxis <= 'z')
+    {
+        y = yaxis - 'a' + 9;
+    }
+
+    move = createMove(x, y, 0);
+
+    if (x < 0 || x >= board->size || y < 0 || y >= board->size)
+    {
+        printError(board, "Invalid move\n");
+        free(move);
+        return humanMakeMove(board, player, Opponent, outfile);
+    }
+
+    if (board->cells[x][y] == EMPTY)
+    {
+        printError(board, "Empty cell\n");
+        free(move);
+        return humanMakeMove(board, player, Opponent, outfile);
+    }
+
+    if (isNextMoveAvailable(board, move) == 0)
+    {
+        printError(board, "No move available\n");
+        free(move);
+        return humanMakeMove(board, player, Opponent, outfile);
+    }
+
+    whitePiece(board, move->PieceX, move->PieceY);
+
+    while (nextMoveAvailable)
+    {
+        int dirValid = 0;
+        Piece c;
+        whitePiece(board, move->PieceX, move->PieceY);
+        printControl(board, COLOR_BLUE "Direction: " COLOR_RESET);
+
+        while (dirValid == 0)
+        {
+            Direction dir = getDirection(board);
+            if (dir == NO_DIRECTION)
+            {
+                return 1;
+            }
+            move->direction = dir;
+            last = *move;
+            c = isMoveValid(board, move);
+            if (c != INVALID_PIECE)
+            {
+                dirValid = 1;
+            }
+            else
+            {
+                printError(board, "Invalid move\n");
+            }
+        }
+        /* calculate the score, */ 
+        score = takePiece(player, c);
+
+        movePiece(board, move);
+        renderBoard(board);
+        move->playerId = player->id;
+        /* ask if redo */ 
+        if (redoAvailable)
+        {
+            printControl(board, "Do you want to undo? " COLOR_RED "(y/n)" COLOR_RESET ": ");
+            char redo;
+            scanf(" %c", &redo);
+            if (redo == 'y' || redo == 'Y')
+            {
+                redoAvailable = 0;
+                /* undo the move */ 
+                undoMove(board, move, c);
+                renderBoard(board);
+                
+                /* undo the score */
+                if (score)
+                {
+                    player->score--;
+                    for (i = 0; i < 5; i++)
+                    {
+                        player->pieces[i]++;
+                    }
+                }
+                player->pieces[c - 'A']--;
+
+
+                printControl(board, "Redo move? " COLOR_RED "(y/n)" COLOR_RESET ": ");
+                char redo;
+                scanf(" %c", &redo);
+                if (redo == 'y' || redo =='Y')
+                {
+                    /* redo the mov, do the first move again */
+                    movePiece(board, &last);
+                }
+                else
+                {
+                    dirValid = 0;
+                    whitePiece(board, move->PieceX, move->PieceY);
+                    while (dirValid == 0)
+                    {
+                        Direction dir = getDirection(board);
+                        if (dir == NO_DIRECTION)
+                        {
+                            return 1;
+                        }
+                        move->direction = dir;
+                        c = isMoveValid(board, move);
+                        if (c != INVALID_PIECE)
+                        {
+                            dirValid = 1;
+                        }
+                        else
+                        {
+                            printError(board, "Invalid move\n");
+                        }
+                    }
+
+                    player->pieces[c - 'A']++;
+                    movePiece(board, move);
+                    renderBoard(board);
+                    move->playerId = player->id;
+                }
+            }
+        }
+        saveMove(outfile, *move);
+        move->PieceX += (move->direction == UP ? -2 : move->direction == DOWN ? 2 : 0);
+        move->PieceY += (move->direction == LEFT ? -2 : move->direction == RIGHT ? +2 : 0);
+        nextMoveAvailable = isNextMoveAvailable(board, move);
+    }
+
+    free(move);
+    return 1;
+}
+
+/* Calculate the best score for a given position and direction.
+ *
+ * Parameters:
+ *     N: the size of the matrix (assuming it's a square matrix).
+ *     matrix: a pointer to a 2D array representing the game matrix.
+ *     posY: the y-coordinate of the current position.
+ *     posX: the x-coordinate of the current position.
+ *     direction: a pointer to a Direction variable to set the best direction.
+ *
+ * Returns:
+ *     The best score calculated for the given position and direction.
+ */
+int calculateBestScore(int N, int **matrix, int posY, int posX, Direction *direction)
+{
+    int tmpScore;
+    int score = 0;
+    Direction tmp_direction = 0;
+    int maxScore = 0;
+
+    /* check if can move up */
+    if (
+        posX - 2 >= 0 &&
+        matrix[posX - 2][posY] == 0 &&
+        matrix[posX - 1][posY] != 0
+    )
+    {
+        /* simulate move */
+        tmpScore = matrix[posX - 1][posY];
+        matrix[posX - 2][posY] = matrix[posX][posY];
+        matrix[posX][posY] = 0;
+        matrix[posX - 1][posY] = 0;
+        tmp_direction = UP;
+        score = tmpScore + calculateBestScore(N, matrix, posY, posX - 2, &tmp_direction);
+        if (score > maxScore)
+        {
+            maxScore = score;
+            *direction = UP;
+        }
+        /* undo move */
+        matrix[posX][posY] = matrix[posX - 2][posY];
+        matrix[posX - 2][posY] = 0;
+        matrix[posX - 1][posY] = tmpScore;
+    }
+
+    /* check if can move down */
+    if (
+        posX + 2 < N &&
+        matrix[posX + 2][posY] == 0 &&
+        matrix[posX + 1][posY] != 0
+    )
+    {
+        /* simulate move */
+        tmpScore = matrix[posX + 1][posY];
+        matrix[posX + 2][posY] = matrix[posX][posY];
+        matrix[posX][posY] = 0;
+        matrix[posX + 1][posY] = 0;
+        tmp_direction = DOWN;
+        score = tmpScore + calculateBestScore(N, matrix, posY, posX + 2, &tmp_direction);
+        if (score > maxScore)
+        {
+            maxScore = score;
+            *direction = DOWN;
+        }
+        /* undo move */
+        matrix[posX][posY] = matrix[posX + 2][posY];
+        matrix[posX + 2][posY] = 0;
+        matrix[posX + 1][posY] = tmpScore;
+    }
+
+    /* check if can move left */
+    if (
+        posY - 2 >= 0 &&
+        matrix[posX][posY - 2] == 0 &&
+        matrix[posX][posY - 1] != 0
+    )
+    {
+        /* simulate move */
+        tmpScore = matrix[posX][posY - 1];
+        matrix[posX][posY - 2] = matrix[posX][posY];
+        matrix[posX][posY] = 0;
+        matrix[posX][posY - 1] = 0;
+        tmp_direction = LEFT;
+        score = tmpScore + calculateBestScore(N, matrix, posY - 2, posX, &tmp_direction);
+        if (score > maxScore)
+        {
+            maxScore = score;
+            *direction = LEFT;
+        }
+        /* undo move */
+        matrix[posX][posY] = matrix[posX][posY - 2];
+        matrix[posX][posY - 2] = 0;
+        matrix[posX][posY - 1] = tmpScore;
+    }
+
+    /* check if can move right */
+    if (
+        posY + 2 < N &&
+        matrix[posX][posY + 2] == 0 &&
+        matrix[posX][posY + 1] != 0
+    )
+    {
+        /* simulate move */
+        tmpScore = matrix[posX][posY + 1];
+        matrix[posX][posY + 2] = matrix[posX][posY];
+        matrix[posX][posY] = 0;
+        matrix[posX][posY + 1] = 0;
+        tmp_direction = RIGHT;
+        score = tmpScore + calculateBestScore(N, matrix, posY + 2, posX, &tmp_direction);
+        if (score > maxScore)
+        {
+            maxScore = score;
+            *direction = RIGHT;
+        }
+        /* undo move */
+        matrix[posX][posY] = matrix[posX][posY + 2];
+        matrix[posX][posY + 2] = 0;
+        matrix[posX][posY + 1] = tmpScore;
+    }
+    return maxScore;
+}
+
+/* Weight of each colour for the computer, same rule as the old matrix:
+ * 1 for any piece, doubled if the opponent still holds that colour and
+ * doubled again if the player is missing it.
+ */
+void chainWeights(Player *player, Player *opponent, int weights[5])
+{
+    int k;
+    for (k = 0; k < 5; k++)
+    {
+        weights[k] = 1;
+        if (opponent->pieces[k] != 0)
+            weights[k] *= 2;
+        if (player->pieces[k] == 0)
+            weights[k] *= 2;
+    }
+}
+
+/* Milliseconds from a monotonic clock */
+uint64_t monotonicMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Take one hop from cell index pos in direction dir. The caller has
+ * already checked that the hop is legal.
+ *
+ * Returns:
+ *     The piece that was taken.
+ */
+Piece hopPiece(Board *board, int pos, Direction dir)
+{
+    int x = pos / board->size, y = pos % board->size;
+    int dx = directionDX[dir], dy = directionDY[dir];
+    Piece taken = board->cells[x + dx][y + dy];
+    setCell(board, x + 2 * dx, y + 2 * dy, board->cells[x][y]);
+    setCell(board, x, y, EMPTY);
+    setCell(board, x + dx, y + dy, EMPTY);
+    return taken;
+}
+
+/* Reverse hopPiece */
+void unhopPiece(Board *board, int pos, Direction dir, Piece taken)
+{
+    int x = pos / board->size, y = pos % board->size;
+    int dx = directionDX[dir], dy = directionDY[dir];
+    setCell(board, x, y, board->cells[x + 2 * dx][y + 2 * dy]);
+    setCell(board, x + 2 * dx, y + 2 * dy, EMPTY);
+    setCell(board, x + dx, y + dy, taken);
+}
+
+/* Check whether the piece on cell index pos can hop in direction dir */
+int canHop(Board *board, int pos, Direction dir)
+{
+    int N = board->size;
+    int x = pos / N + 2 * directionDX[dir];
+    int y = pos % N + 2 * directionDY[dir];
+    if (x < 0 || x >= N || y < 0 || y >= N)
+        return 0;
+    return BB_TEST(board->bits.occupied, pos + directionDX[dir] * N + directionDY[dir]) &&
+           !BB_TEST(board->bits.occupied, x * N + y);
+}
+
+/* Best continuation from the piece on cell pos. Results are cached on
+ * (pos, board hash) so every intermediate position is searched once
+ * no matter in which order its jumps were made.
+ *
+ * Returns:
+ *     The weighted score of the best chain continuing from pos.
+ */
+int chainBest(ChainSearch *cs, int pos)
+{
+    Board *board = cs->board;
+    ChainMemoEntry *entry = &cs->memo[(board->hash ^ (uint64_t)pos * 0x9E3779B97F4A7C15ULL) & cs->memoMask];
+    int best = 0, score, step;
+    int bestDir = NO_DIRECTION;
+    Direction d;
+    Piece taken;
+
+    if (entry->generation == cs->generation && entry->hash == board->hash && entry->landing == pos)
+    {
+        return entry->score;
+    }
+
+    for (d = UP; d <= RIGHT; d++)
+    {
+        if (!canHop(board, pos, d))
+            continue;
+        step = directionDX[d] * board->size + directionDY[d];
+        taken = hopPiece(board, pos, d);
+        score = cs->weights[taken - 'A'] + chainBest(cs, pos + 2 * step);
+        unhopPiece(board, pos, d, taken);
+        if (score > best)
+        {
+            best = score;
+            bestDir = d;
+        }
+    }
+
+    /* the slot may have been reused by the recursion, refresh it */
+    entry = &cs->memo[(board->hash ^ (uint64_t)pos * 0x9E3779B97F4A7C15ULL) & cs->memoMask];
+    entry->hash = board->hash;
+    entry->landing = pos;
+    entry->generation = cs->generation;
+    entry->score = best;
+    entry->direction = bestDir;
+    return best;
+}
+
+/* Follow the memo from pos and write the best chain's directions.
+ * Evicted entries are searched again, which refills them.
+ */
+void chainExtract(ChainSearch *cs, int pos, Chain *chain)
+{
+    Board *board = cs->board;
+    ChainMemoEntry *entry;
+    Piece taken[MAX_CHAIN];
+    int path[MAX_CHAIN];
+    int i, step;
+    Direction d;
+
+    chain->length = 0;
+    while (chain->length < MAX_CHAIN)
+    {
+        chainBest(cs, pos);
+        entry = &cs->memo[(board->hash ^ (uint64_t)pos * 0x9E3779B97F4A7C15ULL) & cs->memoMask];
+        if (entry->direction == NO_DIRECTION)
+            break;
+        d = entry->direction;
+        step = directionDX[d] * board->size + directionDY[d];
+        path[chain->length] = pos;
+        chain->dirs[chain->length] = d;
+        taken[chain->length] = hopPiece(board, pos, d);
+        chain->length++;
+        pos += 2 * step;
+    }
+
+    for (i = chain->length - 1; i >= 0; i--)
+    {
+        unhopPiece(board, path[i], chain->dirs[i], taken[i]);
+    }
+}
+
+/* Start a chain search for one turn on the given board */
+void chainSearchBegin(ChainSearch *cs, Board *board, int weights[5])
+{
+    int i;
+    cs->board = board;
+    for (i = 0; i < 5; i++)
+    {
+        cs->weights[i] = weights[i];
+    }
+    cs->deadline = 0;
+    cs->stopped = 0;
+    cs->generation++;
+    if (cs->generation == 0)
+    {
+        memset(cs->memo, 0, (cs->memoMask + 1) * sizeof(ChainMemoEntry));
+        cs->generation = 1;
+    }
+}
+
+/* Find the chain with the highest weighted score over all start cells.
+ *
+ * Parameters:
+ *     cs: chain search prepared with chainSearchBegin
+ *     chain: filled with the best chain
+ *
+ * Returns:
+ *     The score of the best chain, 0 if there is no legal jump. Past
+ *     cs->deadline the best of the start cells searched so far.
+ */
+int findBestChain(ChainSearch *cs, Chain *chain)
+{
+    JumpList jumps;
+    int k, score, from;
+
+    chain->from = -1;
+    chain->length = 0;
+    chain->score = 0;
+    generateJumps(cs->board, &jumps);
+    for (k = 0; k < jumps.count; k++)
+    {
+        /* jumps are ordered by cell, search each starting cell once */
+        if (k > 0 && jumps.jumps[k].from == jumps.jumps[k - 1].from)
+            continue;
+        from = jumps.jumps[k].from;
+        score = chainBest(cs, from);
+        if (score > chain->score)
+        {
+            chain->score = score;
+            chain->from = from;
+        }
+        /* out of time, play the best chain found so far */
+        if (cs->deadline && chain->from >= 0 && monotonicMs() >= cs->deadline)
+        {
+            cs->stopped = 1;
+            break;
+        }
+    }
+
+    if (chain->from >= 0)
+    {
+        chainExtract(cs, chain->from, chain);
+    }
+    return chain->score;
+}
+
+/* Play a chain for the player, scoring and saving every hop. Nothing
+ * is saved when outfile is NULL.
+ *
+ * Returns:
+ *     1 if the whole chain was played, 0 if a hop turned out invalid.
+ */
+int playChain(Board *board, Player *player, Chain *chain, char *outfile)
+{
+    Move move;
+    Piece c;
+    int i;
+
+    move.PieceX = chain->from / board->size;
+    move.PieceY = chain->from % board->size;
+    move.playerId = player->id;
+    move.next = NULL;
+    for (i = 0; i < chain->length; i++)
+    {
+        move.direction = chain->dirs[i];
+        c = isMoveValid(board, &move);
+        if (c == INVALID_PIECE)
+        {
+            return 0;
+        }
+        takePiece(player, c);
+        movePiece(board, &move);
+        if (outfile != NULL)
+            saveMove(outfile, move);
+        move.PieceX += 2 * directionDX[move.direction];
+        move.PieceY += 2 * directionDY[move.direction];
+    }
+    return 1;
+}
+
+/* Create a transposition table. The size is rounded down to a power of
+ * two, with a minimum of one bucket.
+ */
+TransTable *ttCreate(size_t entries)
+{
+    TransTable *tt = (TransTable *)malloc(sizeof(TransTable));
+    size_t size = 2;
+    while (size * 2 <= entries)
+    {
+        size *= 2;
+    }
+    tt->entries = (TTEntry *)calloc(size, sizeof(TTEntry));
+    tt->mask = size - 1;
+    tt->age = 0;
+    tt->probes = 0;
+    tt->hits = 0;
+    return tt;
+}
+
+void ttFree(TransTable *tt)
+{
+    if (tt == NULL)
+        return;
+    free(tt->entries);
+    free(tt);
+}
+
+/* Start a new search, entries of older searches are replaced first */
+void ttNewSearch(TransTable *tt)
+{
+    tt->age++;
+}
+
+/* Look up a position.
+ *
+ * Returns:
+ *     The entry for key, or NULL if it is not in the table.
+ */
+TTEntry *ttProbe(TransTable *tt, uint64_t key)
+{
+    TTEntry *bucket = &tt->entries[key & tt->mask & ~(size_t)1];
+    tt->probes++;
+    if (bucket[0].key == key && bucket[0].depth > 0)
+    {
+        tt->hits++;
+        return &bucket[0];
+    }
+    if (bucket[1].key == key && bucket[1].depth > 0)
+    {
+        tt->hits++;
+        return &bucket[1];
+    }
+    return NULL;
+}
+
+/* Store a search result. The slot with the same key is overwritten,
+ * otherwise the entry from an older search or with less depth is.
+ */
+void ttStore(TransTable *tt, uint64_t key, int score, int depth, Bound bound, Chain *chain)
+{
+    TTEntry *bucket = &tt->entries[key & tt->mask & ~(size_t)1];
+    TTEntry *entry;
+    int i;
+
+    if (bucket[0].key == key || bucket[0].depth == 0)
+        entry = &bucket[0];
+    else if (bucket[1].key == key || bucket[1].depth == 0)
+        entry = &bucket[1];
+    else if (bucket[0].age != tt->age && bucket[1].age == tt->age)
+        entry = &bucket[0];
+    else if (bucket[1].age != tt->age && bucket[0].age == tt->age)
+        entry = &bucket[1];
+    else
+        entry = bucket[0].depth <= bucket[1].depth ? &bucket[0] : &bucket[1];
+
+    /* keep a deeper result of the same position from this search */
+    if (entry->key == key && entry->age == tt->age && entry->depth > depth)
+        return;
+
+    entry->key = key;
+    entry->score = score;
+    entry->depth = depth < 1 ? 1 : depth > 255 ? 255 : depth;
+    entry->bound = bound;
+    entry->age = tt->age;
+    entry->chain.from = -1;
+    entry->chain.length = 0;
+    if (chain != NULL && chain->from >= 0 && chain->length <= TT_CHAIN_HOPS)
+    {
+        entry->chain.from = chain->from;
+        entry->chain.length = chain->length;
+        memset(entry->chain.dirs, 0, sizeof(entry->chain.dirs));
+        for (i = 0; i < chain->length; i++)
+        {
+            entry->chain.dirs[i >> 2] |= chain->dirs[i] << ((i & 3) * 2);
+        }
+    }
+}
+
+/* Unpack the chain of an entry.
+ *
+ * Returns:
+ *     1 if the entry holds a chain, 0 otherwise.
+ */
+int ttChain(TTEntry *entry, Chain *chain)
+{
+    int i;
+    if (entry->chain.from < 0)
+        return 0;
+    chain->from = entry->chain.from;
+    chain->length = entry->chain.length;
+    chain->score = entry->score;
+    for (i = 0; i < chain->length; i++)
+    {
+        chain->dirs[i] = (entry->chain.dirs[i >> 2] >> ((i & 3) * 2)) & 3;
+    }
+    return 1;
+}
+
+/* Create a shared table with about the given number of slots */
+SharedTable *sharedCreate(size_t entries)
+{
+    SharedTable *table = (SharedTable *)malloc(sizeof(SharedTable));
+    size_t size = SHARED_BUCKET;
+    while (size * 2 <= entries)
+    {
+        size *= 2;
+    }
+    table->slots = (SharedSlot *)calloc(size, sizeof(SharedSlot));
+    table->mask = size - 1;
+    table->age = 0;
+    return table;
+}
+
+void sharedFree(SharedTable *table)
+{
+    if (table == NULL)
+        return;
+    free(table->slots);
+    free(table);
+}
+
+/* data layout: score 24 bits, depth 8, bound 2, age 8, move + 1 12 */
+uint64_t sharedPack(int score, int depth, Bound bound, int age, int move)
+{
+    return ((uint64_t)(score + EVAL_INF) & 0xFFFFFF) |
+           ((uint64_t)(depth & 0xFF) << 24) |
+           ((uint64_t)(bound & 3) << 32) |
+           ((uint64_t)(age & 0xFF) << 34) |
+           ((uint64_t)((move + 1) & 0xFFF) << 42);
+}
+
+/* Look up a position in the shared table.
+ *
+ * Returns:
+ *     1 and fills entry if a verified slot for key exists, 0 otherwise.
+ */
+int sharedProbe(SharedTable *table, uint64_t key, TTEntry *entry)
+{
+    SharedSlot *bucket = &table->slots[key & table->mask & ~(size_t)(SHARED_BUCKET - 1)];
+    uint64_t data, check;
+    int i;
+
+    for (i = 0; i < SHARED_BUCKET; i++)
+    {
+        data = __atomic_load_n(&bucket[i].data, __ATOMIC_RELAXED);
+        check = __atomic_load_n(&bucket[i].check, __ATOMIC_RELAXED);
+        if ((check ^ data) == key && data != 0)
+        {
+            entry->key = key;
+            entry->score = (int)(data & 0xFFFFFF) - EVAL_INF;
+            entry->depth = (data >> 24) & 0xFF;
+            entry->bound = (data >> 32) & 3;
+            entry->age = (data >> 34) & 0xFF;
+            entry->move = (short)((data >> 42) & 0xFFF) - 1;
+            entry->chain.from = -1;
+            entry->chain.length = 0;
+            return entry->depth > 0;
+        }
+    }
+    return 0;
+}
+
+/* Store a result in the shared table without locking. The slot with
+ * the same key is reused, otherwise the one from an older search or
+ * with the least depth. Concurrent stores may overwrite each other,
+ * which only loses information.
+ */
+void sharedStore(SharedTable *table, uint64_t key, int score, int depth, Bound bound, int move)
+{
+    SharedSlot *bucket = &table->slots[key & table->mask & ~(size_t)(SHARED_BUCKET - 1)];
+    SharedSlot *victim = &bucket[0];
+    uint64_t data, check, packed;
+    int i, slotDepth, victimRank = 1 << 30, rank;
+
+    if (depth < 1)
+        depth = 1;
+    if (depth > 255)
+        depth = 255;
+    for (i = 0; i < SHARED_BUCKET; i++)
+    {
+        data = __atomic_load_n(&bucket[i].data, __ATOMIC_RELAXED);
+        check = __atomic_load_n(&bucket[i].check, __ATOMIC_RELAXED);
+        if ((check ^ data) == key)
+        {
+            victim = &bucket[i];
+            if ((int)((data >> 24) & 0xFF) > depth && (int)((data >> 34) & 0xFF) == table->age)
+                return;
+            break;
+        }
+        slotDepth = (data >> 24) & 0xFF;
+        rank = slotDepth + (((data >> 34) & 0xFF) == table->age ? 256 : 0);
+        if (data == 0)
+            rank = -1;
+        if (rank < victimRank)
+        {
+            victimRank = rank;
+            victim = &bucket[i];
+        }
+    }
+
+    packed = sharedPack(score, depth, bound, table->age, move);
+    __atomic_store_n(&victim->data, packed, __ATOMIC_RELAXED);
+    __atomic_store_n(&victim->check, key ^ packed, __ATOMIC_RELAXED);
+}
+
+/* Check that every hop of a chain is legal on the board */
+int isChainLegal(Board *board, Chain *chain)
+{
+    Piece taken[MAX_CHAIN];
+    int path[MAX_CHAIN];
+    int pos = chain->from, i, legal = 1, step;
+
+    if (pos < 0 || pos >= board->size * board->size || !BB_TEST(board->bits.occupied, pos))
+        return 0;
+    for (i = 0; i < chain->length; i++)
+    {
+        if (!canHop(board, pos, chain->dirs[i]))
+        {
+            legal = 0;
+            break;
+        }
+        step = directionDX[chain->dirs[i]] * board->size + directionDY[chain->dirs[i]];
+        path[i] = pos;
+        taken[i] = hopPiece(board, pos, chain->dirs[i]);
+        pos += 2 * step;
+    }
+    while (--i >= 0)
+    {
+        unhopPiece(board, path[i], chain->dirs[i], taken[i]);
+    }
+    return legal && chain->length > 0;
+}
+
+/* Greedy search: the chain with the best weighted capture this turn.
+ * Results are exact, so they go to the table with depth 1.
+ */
+void greedyBestChain(SearchContext *ctx, Board *board, Player *player, Player *opponent, Chain *chain)
+{
+    int weights[5];
+    TTEntry *entry;
+    uint64_t key;
+
+    /* the weights depend only on the pieces, which are part of the key */
+    key = positionKey(board, player, opponent);
+    entry = ttProbe(ctx->tt, key);
+    chain->length = 0;
+    if (entry != NULL && entry->bound == BOUND_EXACT && ttChain(entry, chain) && isChainLegal(board, chain))
+    {
+        return;
+    }
+
+    chainWeights(player, opponent, weights);
+    chainSearchBegin(&ctx->chains, board, weights);
+    ctx->chains.deadline = ctx->deadline;
+    findBestChain(&ctx->chains, chain);
+    if (!ctx->chains.stopped)
+        ttStore(ctx->tt, key, chain->score, 1, BOUND_EXACT, chain);
+}
+
+/* Add the chain in dirs to the list, if there is room */
+void chainListAdd(ChainList *list, Board *board, int from, unsigned char *dirs, int length)
+{
+    ChainRef *ref;
+    if (list->count >= CHAIN_LIST_MAX || list->poolUsed + length > CHAIN_POOL_SIZE)
+    {
+        list->truncated = 1;
+        return;
+    }
+    ref = &list->chains[list->count];
+    ref->from = from;
+    ref->length = length;
+    ref->offset = list->poolUsed;
+    ref->order = list->count;
+    ref->endHash = board->hash;
+    memcpy(&list->pool[list->poolUsed], dirs, length);
+    list->poolUsed += length;
+    list->count++;
+}
+
+void chainListWalk(ChainList *list, Board *board, int from, int pos, unsigned char *dirs, int length, int flags)
+{
+    int canContinue = 0, step;
+    Direction d;
+    Piece taken;
+
+    if (list->truncated)
+        return;
+    for (d = UP; d <= RIGHT; d++)
+    {
+        if (!canHop(board, pos, d))
+            continue;
+        canContinue = 1;
+        step = directionDX[d] * board->size + directionDY[d];
+        dirs[length] = d;
+        taken = hopPiece(board, pos, d);
+        chainListWalk(list, board, from, pos + 2 * step, dirs, length + 1, flags);
+        unhopPiece(board, pos, d, taken);
+    }
+
+    if (length > 0 && (!(flags & CHAINS_MAXIMAL) || !canContinue))
+    {
+        chainListAdd(list, board, from, dirs, length);
+    }
+}
+
+int compareChainRefByHash(const void *a, const void *b)
+{
+    const ChainRef *x = (const ChainRef *)a, *y = (const ChainRef *)b;
+    if (x->endHash != y->endHash)
+        return x->endHash < y->endHash ? -1 : 1;
+    return x->order - y->order;
+}
+
+int compareChainRefByOrder(const void *a, const void *b)
+{
+    return ((const ChainRef *)a)->order - ((const ChainRef *)b)->order;
+}
+
+/* Generate every chain the side to move can play.
+ *
+ * Parameters:
+ *     board: the game board
+ *     list: filled with the chains, in start cell and direction order
+ *     flags: CHAINS_MAXIMAL keeps only chains that cannot go on,
+ *            CHAINS_UNIQUE drops chains ending in the same position
+ *
+ * Returns:
+ *     The number of chains.
+ */
+int generateChains(Board *board, ChainList *list, int flags)
+{
+    JumpList jumps;
+    unsigned char dirs[MAX_CHAIN];
+    int k, n;
+
+    list->count = 0;
+    list->poolUsed = 0;
+    list->truncated = 0;
+    generateJumps(board, &jumps);
+    for (k = 0; k < jumps.count; k++)
+    {
+        if (k > 0 && jumps.jumps[k].from == jumps.jumps[k - 1].from)
+            continue;
+        chainListWalk(list, board, jumps.jumps[k].from, jumps.jumps[k].from, dirs, 0, flags);
+    }
+
+    if ((flags & CHAINS_UNIQUE) && list->count > 1)
+    {
+        /* the cells taken decide the position, keep the first of each */
+        qsort(list->chains, list->count, sizeof(ChainRef), compareChainRefByHash);
+        n = 1;
+        for (k = 1; k < list->count; k++)
+        {
+            if (list->chains[k].endHash != list->chains[n - 1].endHash)
+                list->chains[n++] = list->chains[k];
+        }
+        list->count = n;
+        qsort(list->chains, list->count, sizeof(ChainRef), compareChainRefByOrder);
+    }
+    return list->count;
+}
+
+/* Copy a chain of the list into a Chain */
+void chainListGet(ChainList *list, int i, Chain *chain)
+{
+    ChainRef *ref = &list->chains[i];
+    chain->from = ref->from;
+    chain->length = ref->length;
+    chain->score = 0;
+    memcpy(chain->dirs, &list->pool[ref->offset], ref->length);
+}
+
+/* Play a chain in the search, saving the mover's pieces for unmakeChain */
+void makeChain(Board *board, Player *mover, ChainList *list, int i, Piece *taken, int saved[6])
+{
+    ChainRef *ref = &list->chains[i];
+    unsigned char *dirs = &list->pool[ref->offset];
+    int pos = ref->from, k;
+
+    for (k = 0; k < 5; k++)
+        saved[k] = mover->pieces[k];
+    saved[5] = mover->score;
+    for (k = 0; k < ref->length; k++)
+    {
+        taken[k] = hopPiece(board, pos, dirs[k]);
+        takePiece(mover, taken[k]);
+        pos += 2 * (directionDX[dirs[k]] * board->size + directionDY[dirs[k]]);
+    }
+}
+
+void unmakeChain(Board *board, Player *mover, ChainList *list, int i, Piece *taken, int saved[6])
+{
+    ChainRef *ref = &list->chains[i];
+    unsigned char *dirs = &list->pool[ref->offset];
+    int path[MAX_CHAIN];
+    int pos = ref->from, k;
+
+    for (k = 0; k < ref->length; k++)
+    {
+        path[k] = pos;
+        pos += 2 * (directionDX[dirs[k]] * board->size + directionDY[dirs[k]]);
+    }
+    for (k = ref->length - 1; k >= 0; k--)
+    {
+        unhopPiece(board, path[k], dirs[k], taken[k]);
+    }
+    for (k = 0; k < 5; k++)
+        mover->pieces[k] = saved[k];
+    mover->score = saved[5];
+}
+
+/* Evaluate a position for the side to move with the scoring rule of
+ * loadScores: completed sets first, leftover pieces as a tie-break.
+ */
+int evaluate(Player *me, Player *opp, int gameOver)
+{
+    int value = (me->score - opp->score) * EVAL_SET;
+    int k;
+    for (k = 0; k < 5; k++)
+    {
+        value += me->pieces[k] - opp->pieces[k];
+    }
+    if (gameOver)
+    {
+        if (me->score > opp->score)
+            value += EVAL_WIN;
+        else if (me->score < opp->score)
+            value -= EVAL_WIN;
+    }
+    return value;
+}
+
+/* Find the index of a chain in the list, -1 if it is not there */
+int chainListFind(ChainList *list, Chain *chain)
+{
+    int i;
+    for (i = 0; i < list->count; i++)
+    {
+        if (list->chains[i].from == chain->from && list->chains[i].length == chain->length &&
+            memcmp(&list->pool[list->chains[i].offset], chain->dirs, chain->length) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* Move ordering: the hinted chain first, then longer chains */
+void orderChains(ChainList *list, int first, int *order)
+{
+    int i, j, tmp;
+    for (i = 0; i < list->count; i++)
+        order[i] = i;
+    for (i = 1; i < list->count; i++)
+    {
+        tmp = order[i];
+        for (j = i; j > 0 && list->chains[order[j - 1]].length < list->chains[tmp].length; j--)
+            order[j] = order[j - 1];
+        order[j] = tmp;
+    }
+    if (first >= 0)
+    {
+        for (i = 0; order[i] != first; i++)
+            ;
+        for (; i > 0; i--)
+            order[i] = order[i - 1];
+        order[0] = first;
+    }
+}
+
+/* Negamax with alpha-beta pruning, one full chain per ply.
+ *
+ * Parameters:
+ *     search: the search state
+ *     me, opp: the side to move and the other side
+ *     depth: remaining plies
+ *     alpha, beta: the search window
+ *     ply: distance from the root
+ *
+ * Returns:
+ *     The value of the position for the side to move.
+ */
+int negamax(Search *search, Player *me, Player *opp, int depth, int alpha, int beta, int ply)
+{
+    Board *board = search->board;
+    ChainList *list = &search->lists[ply];
+    Piece taken[MAX_CHAIN];
+    int saved[6];
+    int order[CHAIN_LIST_MAX];
+    int alphaStart = alpha, best = -EVAL_INF, bestIndex = -1;
+    int i, value, hint = -1;
+    uint64_t key = searchKey(board, me, opp);
+    TTEntry stored;
+    TTEntry *entry = NULL;
+    Chain chain;
+
+    search->nodes++;
+    if ((search->nodes & (SEARCH_CHECK_NODES - 1)) == 0 && search->abortable)
+    {
+        if (search->deadline && monotonicMs() >= search->deadline)
+            search->stopped = 1;
+        if (search->stop != NULL && __atomic_load_n(search->stop, __ATOMIC_RELAXED))
+            search->stopped = 1;
+    }
+    if (search->stopped)
+        return 0;
+
+    if (search->shared != NULL)
+    {
+        if (sharedProbe(search->shared, key, &stored))
+            entry = &stored;
+    }
+    else
+    {
+        entry = ttProbe(search->tt, key);
+    }
+    if (entry != NULL)
+    {
+        if (entry->depth >= depth && ply > 0)
+        {
+            if (entry->bound == BOUND_EXACT)
+                return entry->score;
+            if (entry->bound == BOUND_LOWER && entry->score >= beta)
+                return entry->score;
+            if (entry->bound == BOUND_UPPER && entry->score <= alpha)
+                return entry->score;
+        }
+    }
+
+    if (depth == 0 || ply >= SEARCH_MAX_PLY - 1)
+    {
+        return evaluate(me, opp, 0);
+    }
+
+    if (generateChains(board, list, CHAINS_MAXIMAL | CHAINS_UNIQUE) == 0)
+    {
+        return evaluate(me, opp, 1);
+    }
+
+    /* principal variation first: the table move, or last iteration's
+     * best root chain */
+    if (ply == 0 && search->pv.length > 0)
+        hint = chainListFind(list, &search->pv);
+    else if (entry != NULL && search->shared != NULL)
+        hint = entry->move < list->count ? entry->move : -1;
+    else if (entry != NULL && ttChain(entry, &chain))
+        hint = chainListFind(list, &chain);
+    orderChains(list, hint, order);
+
+    for (i = 0; i < list->count; i++)
+    {
+        makeChain(board, me, list, order[i], taken, saved);
+        value = -negamax(search, opp, me, depth - 1, -beta, -alpha, ply + 1);
+        unmakeChain(board, me, list, order[i], taken, saved);
+        if (search->stopped)
+            return 0;
+
+        if (value > best)
+        {
+            best = value;
+            bestIndex = order[i];
+            if (ply == 0)
+            {
+                chainListGet(list, bestIndex, &search->best);
+                search->best.score = best;
+            }
+        }
+        /* once the root has a chain to play, the search may stop */
+        if (ply == 0)
+            search->abortable = 1;
+        if (value > alpha)
+            alpha = value;
+        if (alpha >= beta)
+            break;
+    }
+
+    chainListGet(list, bestIndex, &chain);
+    chain.score = best;
+    if (ply == 0)
+        search->best = chain;
+    if (search->shared != NULL)
+        sharedStore(search->shared, key, best, depth,
+                    best <= alphaStart ? BOUND_UPPER : best >= beta ? BOUND_LOWER : BOUND_EXACT, bestIndex);
+    else
+        ttStore(search->tt, key, best, depth,
+                best <= alphaStart ? BOUND_UPPER : best >= beta ? BOUND_LOWER : BOUND_EXACT, &chain);
+    return best;
+}
+
+/* Alpha-beta search with iterative deepening. Each iteration starts
+ * with the best chain of the previous one. With a time budget the
+ * search stops at the deadline and keeps the last completed iteration;
+ * the first iteration always completes so there is a move to play.
+ */
+void searchBestChain(SearchContext *ctx, Board *board, Player *player, Player *opponent, Chain *chain)
+{
+    Search search;
+    Player me = *player, opp = *opponent;
+    int depth, maxDepth = aiConfig.maxDepth;
+    uint64_t start = monotonicMs();
+
+    if (maxDepth == 0)
+        maxDepth = aiConfig.moveTimeMs ? SEARCH_MAX_PLY - 1 : SEARCH_DEFAULT_DEPTH;
+
+    search.board = board;
+    search.tt = ctx->tt;
+    search.shared = NULL;
+    search.stop = NULL;
+    search.lists = ctx->lists[0];
+    search.nodes = 0;
+    search.depthReached = 0;
+    search.deadline = ctx->deadline;
+    search.stopped = 0;
+    search.abortable = 0;
+    search.pv.length = 0;
+    search.pv.from = -1;
+    search.best.length = 0;
+    search.best.from = -1;
+
+    for (depth = 1; depth <= maxDepth; depth++)
+    {
+        negamax(&search, &me, &opp, depth, -EVAL_INF, EVAL_INF, 0);
+        if (search.stopped)
+            break;
+        search.pv = search.best;
+        search.depthReached = depth;
+        search.abortable = 1;
+        if (search.best.length == 0)
+            break;
+        if (search.deadline && monotonicMs() >= search.deadline)
+            break;
+    }
+
+    ctx->info.depth = search.depthReached;
+    ctx->info.nodes = search.nodes;
+    ctx->info.elapsedMs = monotonicMs() - start;
+    /* stopped within the first iteration: its best chain so far */
+    *chain = search.pv.length > 0 ? search.pv : search.best;
+}
+
+/* Run the jobs given to a pool thread until the pool is freed */
+void *poolThreadRun(void *arg)
+{
+    PoolThread *self = (PoolThread *)arg;
+    WorkerPool *pool = self->pool;
+    unsigned seen = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        while (!pool->quit && pool->generation == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->quit)
+            break;
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+        pool->job(pool->args + self->index * pool->argSize);
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0)
+            pthread_cond_signal(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Start `count` threads, with the stack a search needs */
+WorkerPool *createWorkerPool(int count)
+{
+    WorkerPool *pool = (WorkerPool *)calloc(1, sizeof(WorkerPool));
+    pthread_attr_t attr;
+    int i;
+
+    pool->threads = (PoolThread *)calloc(count, sizeof(PoolThread));
+    pool->count = count;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK);
+    for (i = 0; i < count; i++)
+    {
+        pool->threads[i].pool = pool;
+        pool->threads[i].index = i + 1;
+        pthread_create(&pool->threads[i].thread, &attr, poolThreadRun, &pool->threads[i]);
+    }
+    pthread_attr_destroy(&attr);
+    return pool;
+}
+
+void freeWorkerPool(WorkerPool *pool)
+{
+    int i;
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (i = 0; i < pool->count; i++)
+        pthread_join(pool->threads[i].thread, NULL);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->threads);
+    free(pool);
+}
+
+/* Hand a job to the pool threads: thread i runs job(args + i * argSize).
+ * The caller runs worker 0 itself and then waits with poolWait.
+ */
+void poolStart(WorkerPool *pool, void *(*job)(void *), void *args, size_t argSize)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->job = job;
+    pool->args = (char *)args;
+    pool->argSize = argSize;
+    pool->running = pool->count;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Wait until every pool thread has finished the job */
+void poolWait(WorkerPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->running > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Search the root chains order[index], order[index + stride], ... of
+ * one worker with its own board and table.
+ */
+void *rootWorkerRun(void *arg)
+{
+    RootWorker *worker = (RootWorker *)arg;
+    Piece taken[MAX_CHAIN];
+    int saved[6];
+    int i, value, alpha = -EVAL_INF;
+
+    worker->bestValue = -EVAL_INF;
+    worker->bestPos = -1;
+    for (i = worker->index; i < worker->root->count; i += worker->stride)
+    {
+        makeChain(worker->board, &worker->me, worker->root, worker->order[i], taken, saved);
+        value = -negamax(&worker->search, &worker->opp, &worker->me, worker->depth - 1, -EVAL_INF, -alpha, 1);
+        unmakeChain(worker->board, &worker->me, worker->root, worker->order[i], taken, saved);
+        if (worker->search.stopped)
+            break;
+        if (value > worker->bestValue)
+        {
+            worker->bestValue = value;
+            worker->bestPos = i;
+        }
+        /* once this worker has a chain to offer, it may stop */
+        worker->search.abortable = 1;
+        if (value > alpha)
+            alpha = value;
+    }
+    return NULL;
+}
+
+/* Root-parallel alpha-beta. Every iteration splits the ordered root
+ * chains over aiConfig.threads workers, each with a private board and
+ * table, so the split and the results do not depend on timing. The
+ * best value wins and ties go to the chain ordered first, which makes
+ * the chosen move deterministic for a given position and depth.
+ */
+void searchBestChainParallel(SearchContext *ctx, Board *board, Player *player, Player *opponent, Chain *chain)
+{
+    int threads = ctx->threads;
+    RootWorker *workers = ctx->rootWorkers;
+    ChainList *root = ctx->root;
+    int *order = ctx->order;
+    int depth, maxDepth = aiConfig.maxDepth;
+    int w, stopped = 0, bestValue, bestPos;
+    uint64_t start = monotonicMs();
+    uint64_t deadline = ctx->deadline;
+    Chain pv;
+
+    if (maxDepth == 0)
+        maxDepth = aiConfig.moveTimeMs ? SEARCH_MAX_PLY - 1 : SEARCH_DEFAULT_DEPTH;
+
+    for (w = 0; w < threads; w++)
+    {
+        workers[w].board = ctx->boards[w];
+        copyBoardInto(workers[w].board, board);
+        workers[w].me = *player;
+        workers[w].opp = *opponent;
+        memset(&workers[w].search, 0, sizeof(Search));
+        workers[w].search.board = workers[w].board;
+        workers[w].search.tt = ctx->workerTT[w];
+        workers[w].search.lists = ctx->lists[w];
+        workers[w].search.deadline = deadline;
+        workers[w].search.stopped = 0;
+        workers[w].search.abortable = 0;
+        workers[w].search.nodes = 0;
+        workers[w].root = root;
+        workers[w].order = order;
+        workers[w].index = w;
+        workers[w].stride = threads;
+    }
+
+    ctx->info.depth = 0;
+    pv.from = -1;
+    pv.length = 0;
+    generateChains(board, root, CHAINS_MAXIMAL | CHAINS_UNIQUE);
+    for (depth = 1; depth <= maxDepth && root->count > 0 && !stopped; depth++)
+    {
+        orderChains(root, pv.length > 0 ? chainListFind(root, &pv) : -1, order);
+        for (w = 0; w < threads; w++)
+        {
+            workers[w].depth = depth;
+            ttNewSearch(workers[w].search.tt);
+        }
+        poolStart(ctx->pool, rootWorkerRun, workers, sizeof(RootWorker));
+        rootWorkerRun(&workers[0]);
+        poolWait(ctx->pool);
+
+        bestValue = -EVAL_INF;
+        bestPos = -1;
+        for (w = 0; w < threads; w++)
+        {
+            if (workers[w].search.stopped)
+                stopped = 1;
+            if (workers[w].bestPos >= 0 &&
+                (workers[w].bestValue > bestValue ||
+                 (workers[w].bestValue == bestValue && workers[w].bestPos < bestPos)))
+            {
+                bestValue = workers[w].bestValue;
+                bestPos = workers[w].bestPos;
+            }
+        }
+        if (stopped)
+        {
+            /* stopped within the first iteration: its best chain so far */
+            if (pv.length == 0 && bestPos >= 0)
+            {
+                chainListGet(root, order[bestPos], &pv);
+                pv.score = bestValue;
+            }
+            break;
+        }
+
+        chainListGet(root, order[bestPos], &pv);
+        pv.score = bestValue;
+        ctx->info.depth = depth;
+        for (w = 0; w < threads; w++)
+            workers[w].search.abortable = 1;
+        if (deadline && monotonicMs() >= deadline)
+            break;
+    }
+
+    ctx->info.nodes = 0;
+    for (w = 0; w < threads; w++)
+    {
+        ctx->info.nodes += workers[w].search.nodes;
+    }
+    ctx->info.elapsedMs = monotonicMs() - start;
+    *chain = pv;
+}
+
+/* Iterative deepening of one lazy SMP thread */
+void *smpWorkerRun(void *arg)
+{
+    SmpWorker *worker = (SmpWorker *)arg;
+    Search *search = &worker->search;
+    int depth;
+
+    for (depth = worker->startDepth; depth <= worker->maxDepth; depth++)
+    {
+        negamax(search, &worker->me, &worker->opp, depth, -EVAL_INF, EVAL_INF, 0);
+        if (search->stopped)
+            break;
+        search->pv = search->best;
+        search->depthReached = depth;
+        search->abortable = 1;
+        if (search->best.length == 0)
+            break;
+        if (search->deadline && monotonicMs() >= search->deadline)
+            break;
+    }
+    return NULL;
+}
+
+/* Lazy SMP: every thread searches the same root and shares one
+ * lock-free table, so the helpers fill it with results the main thread
+ * reuses. Helpers start at staggered depths to spread the work and are
+ * stopped when the main thread finishes. The main thread's best chain
+ * is played.
+ */
+void searchBestChainLazySmp(SearchContext *ctx, Board *board, Player *player, Player *opponent, Chain *chain)
+{
+    int threads = ctx->threads;
+    SmpWorker *workers = ctx->smpWorkers;
+    int maxDepth = aiConfig.maxDepth;
+    int stop = 0, w;
+    uint64_t start = monotonicMs();
+
+    if (maxDepth == 0)
+        maxDepth = aiConfig.moveTimeMs ? SEARCH_MAX_PLY - 1 : SEARCH_DEFAULT_DEPTH;
+    ctx->shared->age++;
+
+    for (w = 0; w < threads; w++)
+    {
+        workers[w].board = w == 0 ? board : ctx->boards[w];
+        if (w > 0)
+            copyBoardInto(workers[w].board, board);
+        workers[w].me = *player;
+        workers[w].opp = *opponent;
+        memset(&workers[w].search, 0, sizeof(Search));
+        workers[w].search.board = workers[w].board;
+        workers[w].search.shared = ctx->shared;
+        workers[w].search.stop = w == 0 ? NULL : &stop;
+        workers[w].search.lists = ctx->lists[w];
+        workers[w].search.deadline = ctx->deadline;
+        workers[w].search.abortable = w != 0;
+        workers[w].search.pv.from = -1;
+        workers[w].search.best.from = -1;
+        workers[w].startDepth = 1 + (w == 0 ? 0 : w % 3);
+        workers[w].maxDepth = w == 0 ? maxDepth : SEARCH_MAX_PLY - 1;
+    }
+
+    if (ctx->pool != NULL)
+        poolStart(ctx->pool, smpWorkerRun, workers, sizeof(SmpWorker));
+    smpWorkerRun(&workers[0]);
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    if (ctx->pool != NULL)
+        poolWait(ctx->pool);
+
+    ctx->info.depth = workers[0].search.depthReached;
+    ctx->info.nodes = 0;
+    for (w = 0; w < threads; w++)
+        ctx->info.nodes += workers[w].search.nodes;
+    ctx->info.elapsedMs = monotonicMs() - start;
+    *chain = workers[0].search.pv.length > 0 ? workers[0].search.pv : workers[0].search.best;
+}
+
+/* Number of pieces on the board */
+int countPieces(Board *board)
+{
+    int w, count = 0;
+    for (w = 0; w < BB_WORDS; w++)
+        count += __builtin_popcountll(board->bits.occupied[w]);
+    return count;
+}
+
+/* Note that a position is recorded. A position evicted from the table
+ * can be solved again, this keeps it from being added twice.
+ *
+ * Returns:
+ *     1 if the key is new, 0 if it was recorded before.
+ */
+int endgameRecordKey(Endgame *eg, uint64_t key)
+{
+    uint64_t *old = eg->recorded;
+    size_t oldMask = eg->recordedMask, i, at;
+
+    /* grow at half full, the table holds a key per record */
+    if (eg->recorded == NULL || 2 * (eg->count + 1) > eg->recordedMask + 1)
+    {
+        eg->recordedMask = old != NULL ? 2 * oldMask + 1 : 4095;
+        eg->recorded = (uint64_t *)calloc(eg->recordedMask + 1, sizeof(uint64_t));
+        for (i = 0; old != NULL && i <= oldMask; i++)
+        {
+            if (old[i] == 0)
+                continue;
+            for (at = old[i] & eg->recordedMask; eg->recorded[at] != 0; at = (at + 1) & eg->recordedMask)
+                ;
+            eg->recorded[at] = old[i];
+        }
+        free(old);
+    }
+    for (at = key & eg->recordedMask; eg->recorded[at] != 0; at = (at + 1) & eg->recordedMask)
+    {
+        if (eg->recorded[at] == key)
+            return 0;
+    }
+    eg->recorded[at] = key;
+    return 1;
+}
+
+/* Value of a position for the side to move: the sets both sides still
+ * complete until the game ends, EVAL_SET each, and the leftover pieces
+ * as a tie-break, the same rule as evaluate. Every chain a player may
+ * stop at is tried, not only maximal ones. Values depend only on the
+ * board and the pieces in hand, which make the key, so the table stays
+ * valid for the rest of the game. The search is alpha-beta with the
+ * table holding bounds, and the best chain of an earlier visit is
+ * tried first.
+ *
+ * Returns:
+ *     The exact value if it lies inside (alpha, beta), otherwise a bound
+ *     on the side of the window it fails; meaningless once eg->aborted
+ *     is set.
+ */
+int endgameSolve(Endgame *eg, Board *board, Player *me, Player *opp, int ply, int alpha, int beta)
+{
+    ChainList *list = &eg->lists[ply];
+    EndgameEntry *entry;
+    SolvedRecord *record;
+    Piece taken[MAX_CHAIN];
+    int saved[6];
+    uint64_t key = positionKey(board, me, opp);
+    int best, bestIndex = -1, first = -1, alphaIn = alpha, gain, value, i, n, k;
+
+    entry = &eg->table[key & eg->mask];
+    if (entry->key == key)
+    {
+        if (entry->bound == BOUND_EXACT || (entry->bound == BOUND_LOWER && entry->value >= beta) ||
+            (entry->bound == BOUND_UPPER && entry->value <= alpha))
+            return entry->value;
+        first = entry->best;
+    }
+    if (++eg->nodes > eg->limit || ply >= eg->plies ||
+        (eg->deadline && (eg->nodes & (SEARCH_CHECK_NODES - 1)) == 0 && monotonicMs() >= eg->deadline))
+    {
+        eg->aborted = 1;
+        return 0;
+    }
+
+    if (generateChains(board, list, CHAINS_UNIQUE) == 0)
+    {
+        for (k = 0, best = 0; k < 5; k++)
+            best += me->pieces[k] - opp->pieces[k];
+        alphaIn = -EVAL_INF;
+    }
+    else
+    {
+        if (list->truncated)
+        {
+            eg->aborted = 1;
+            return 0;
+        }
+        if (first >= list->count)
+            first = -1;
+        best = -EVAL_INF;
+        for (n = -1; n < list->count && alpha < beta; n++)
+        {
+            i = n < 0 ? first : n;
+            if (i < 0 || (n >= 0 && i == first))
+                continue;
+            makeChain(board, me, list, i, taken, saved);
+            gain = (me->score - saved[5]) * EVAL_SET;
+            value = gain - endgameSolve(eg, board, opp, me, ply + 1, gain - beta, gain - alpha);
+            unmakeChain(board, me, list, i, taken, saved);
+            if (eg->aborted)
+                return 0;
+            if (value > best)
+            {
+                best = value;
+                bestIndex = i;
+            }
+            if (best > alpha)
+                alpha = best;
+        }
+    }
+
+    /* the recursion may have used the slot, look it up again */
+    entry = &eg->table[key & eg->mask];
+    entry->key = key;
+    entry->value = best;
+    entry->bound = best <= alphaIn ? BOUND_UPPER : best >= beta ? BOUND_LOWER : BOUND_EXACT;
+    entry->best = bestIndex;
+    if (eg->records != NULL && entry->bound == BOUND_EXACT && bestIndex >= 0 &&
+        list->chains[bestIndex].length <= SOLVED_CHAIN_HOPS && endgameRecordKey(eg, key))
+    {
+        if (eg->count == eg->capacity)
+        {
+            eg->capacity = eg->capacity ? eg->capacity * 2 : 1024;
+            eg->records = (SolvedRecord *)realloc(eg->records, eg->capacity * sizeof(SolvedRecord));
+        }
+        record = &eg->records[eg->count++];
+        record->key = key;
+        record->value = best;
+        record->from = list->chains[bestIndex].from;
+        record->length = list->chains[bestIndex].length;
+        memset(record->dirs, 0, sizeof(record->dirs));
+        for (k = 0; k < record->length; k++)
+            record->dirs[k >> 2] |= list->pool[list->chains[bestIndex].offset + k] << ((k & 3) * 2);
+    }
+    return best;
+}
+
+/* Allocate an endgame solver.
+ *
+ * Parameters:
+ *     entries: size of the value table, a power of two
+ *     plies: deepest ply, at least the number of pieces of the positions
+ *         it solves
+ *     limit: nodes a solve may visit before it gives up
+ */
+Endgame *createEndgame(size_t entries, int plies, unsigned long limit)
+{
+    Endgame *eg = (Endgame *)calloc(1, sizeof(Endgame));
+    eg->table = (EndgameEntry *)calloc(entries, sizeof(EndgameEntry));
+    eg->mask = entries - 1;
+    eg->lists = (ChainList *)malloc((plies + 1) * sizeof(ChainList));
+    eg->plies = plies;
+    eg->limit = limit;
+    return eg;
+}
+
+void freeEndgame(Endgame *eg)
+{
+    if (eg == NULL)
+        return;
+    free(eg->table);
+    free(eg->lists);
+    free(eg->records);
+    free(eg->recorded);
+    free(eg);
+}
+
+/* Find the optimal chain with the endgame solver, once few enough
+ * pieces are left.
+ *
+ * Returns:
+ *     1 with the chain filled in, 0 if the position has too many pieces
+ *     or is too big to solve within ENDGAME_NODE_LIMIT nodes or half
+ *     the move's time budget.
+ */
+int endgameBestChain(SearchContext *ctx, Board *board, Player *player, Player *opponent, Chain *chain)
+{
+    Endgame *eg;
+    EndgameEntry *entry;
+    Player me = *player, opp = *opponent;
+    uint64_t start = monotonicMs(), key;
+    int value, pieces;
+
+    pieces = countPieces(board);
+    if (pieces > aiConfig.endgamePieces)
+        return 0;
+    if (ctx->endgame == NULL)
+        ctx->endgame = createEndgame(ENDGAME_TABLE, ENDGAME_MAX_PIECES + 1, ENDGAME_NODE_LIMIT);
+    eg = ctx->endgame;
+    eg->nodes = 0;
+    eg->aborted = 0;
+    /* half the time budget, the rest is for the search if it gives up */
+    eg->deadline = ctx->deadline ? start + (ctx->deadline > start ? ctx->deadline - start : 0) / 2 : 0;
+
+    value = endgameSolve(eg, board, &me, &opp, 0, -EVAL_INF, EVAL_INF);
+    key = positionKey(board, &me, &opp);
+    entry = &eg->table[key & eg->mask];
+    if (eg->aborted || entry->key != key || entry->best < 0)
+        return 0;
+    /* the root list is generated again in the same order */
+    if (generateChains(board, &eg->lists[0], CHAINS_UNIQUE) <= entry->best)
+        return 0;
+    chainListGet(&eg->lists[0], entry->best, chain);
+    chain->score = value;
+    ctx->info.depth = pieces;
+    ctx->info.nodes = eg->nodes;
+    ctx->info.elapsedMs = monotonicMs() - start;
+    return 1;
+}
+
+/* Allocate the search context of a computer player for a board of
+ * the given size, using the current aiConfig. Only what the configured
+ * search mode needs is allocated.
+ */
+SearchContext *createSearchContext(int size)
+{
+    SearchContext *ctx = (SearchContext *)calloc(1, sizeof(SearchContext));
+    int threads = aiConfig.mode == AI_GREEDY ? 1 : aiConfig.threads;
+    int w;
+
+    ctx->size = size;
+    ctx->threads = threads;
+    ctx->mode = aiConfig.mode;
+    /* lazy SMP and root splitting search with their own tables */
+    if (ctx->mode == AI_GREEDY || (ctx->mode == AI_ALPHABETA && threads == 1))
+        ctx->tt = ttCreate(aiConfig.ttEntries);
+    ctx->chains.memoMask = CHAIN_MEMO_SIZE - 1;
+    ctx->chains.memo = (ChainMemoEntry *)calloc(CHAIN_MEMO_SIZE, sizeof(ChainMemoEntry));
+    ctx->chains.generation = 0;
+    if (ctx->mode == AI_GREEDY)
+        return ctx;
+
+    ctx->boards = (Board **)calloc(threads, sizeof(Board *));
+    ctx->lists = (ChainList **)calloc(threads, sizeof(ChainList *));
+    for (w = 0; w < threads; w++)
+    {
+        if (w > 0 || threads > 1)
+            ctx->boards[w] = allocBoard(size);
+        ctx->lists[w] = (ChainList *)malloc(SEARCH_MAX_PLY * sizeof(ChainList));
+    }
+    if (ctx->mode == AI_LAZYSMP)
+    {
+        ctx->shared = sharedCreate(aiConfig.ttEntries);
+        ctx->smpWorkers = (SmpWorker *)calloc(threads, sizeof(SmpWorker));
+    }
+    else if (threads > 1)
+    {
+        ctx->workerTT = (TransTable **)calloc(threads, sizeof(TransTable *));
+        for (w = 0; w < threads; w++)
+            ctx->workerTT[w] = ttCreate(aiConfig.ttEntries);
+        ctx->rootWorkers = (RootWorker *)calloc(threads, sizeof(RootWorker));
+        ctx->root = (ChainList *)malloc(sizeof(ChainList));
+        ctx->order = (int *)malloc(CHAIN_LIST_MAX * sizeof(int));
+    }
+    if (threads > 1)
+        ctx->pool = createWorkerPool(threads - 1);
+    return ctx;
+}
+
+void freeSearchContext(SearchContext *ctx)
+{
+    int w;
+    if (ctx == NULL)
+        return;
+    freeWorkerPool(ctx->pool);
+    ttFree(ctx->tt);
+    free(ctx->chains.memo);
+    if (ctx->boards != NULL)
+    {
+        for (w = 0; w < ctx->threads; w++)
+        {
+            if (ctx->boards[w] != NULL)
+                freeBoard(ctx->boards[w]);
+            free(ctx->lists[w]);
+        }
+        free(ctx->boards);
+        free(ctx->lists);
+    }
+    if (ctx->workerTT != NULL)
+    {
+        for (w = 0; w < ctx->threads; w++)
+            ttFree(ctx->workerTT[w]);
+        free(ctx->workerTT);
+    }
+    sharedFree(ctx->shared);
+    free(ctx->rootWorkers);
+    free(ctx->smpWorkers);
+    free(ctx->root);
+    free(ctx->order);
+    freeEndgame(ctx->endgame);
+    free(ctx);
+}
+
+/* Opening book: the chain to play in known positions, so the first
+ * turns of a game on a full board cost no search. The file is
+ *
+ *     header: "SKOB", version, section count, 10 reserved bytes
+ *     sections: 16 bytes each, the board size, 3 reserved bytes, the
+ *         entry count and the offset of the entries
+ *     entries: 32 bytes each, sorted by key: the positionKey, the score
+ *         of the chain, its from cell, length and a reserved byte, and
+ *         its directions at 2 bits per hop
+ *
+ * The book is mapped read-only and looked up by binary search in the
+ * section of the board size. Keys do not depend on the run, so a book
+ * made once serves every game that reaches its positions. Boards from
+ * initBoard are random and practically never repeat; the book pays off
+ * for games on seeded boards, see --seed.
+ */
+#define BOOK_MAGIC "SKOB"
+#define BOOK_VERSION 1
+#define BOOK_HEADER 16
+#define BOOK_SECTION 16
+#define BOOK_ENTRY 32
+
+typedef struct _OpeningBook {
+    int fd;
+    const unsigned char *map;
+    size_t length;
+    int sections;
+} OpeningBook;
+
+/* A book entry in memory, while a book is made */
+typedef struct _BookRecord {
+    int size;
+    uint64_t key;
+    int score;
+    /* of two records with the same key the later one is kept */
+    int order;
+    PackedChain chain;
+} BookRecord;
+
+/* Set with --book */
+OpeningBook *openingBook = NULL;
+
+/* Map an opening book for reading.
+ *
+ * Returns:
+ *     The book, or NULL if the file cannot be mapped or is not a valid
+ *     book.
+ */
+OpeningBook *openBook(char *filename)
+{
+    OpeningBook *book;
+    const unsigned char *section;
+    struct stat st;
+    void *map;
+    int fd = open(filename, O_RDONLY), valid, i;
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < BOOK_HEADER ||
+        (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+    book = (OpeningBook *)malloc(sizeof(OpeningBook));
+    book->fd = fd;
+    book->map = (const unsigned char *)map;
+    book->length = st.st_size;
+    book->sections = book->map[5];
+    valid = memcmp(book->map, BOOK_MAGIC, 4) == 0 && book->map[4] == BOOK_VERSION &&
+            BOOK_HEADER + (size_t)book->sections * BOOK_SECTION <= book->length;
+    for (i = 0; valid && i < book->sections; i++)
+    {
+        section = book->map + BOOK_HEADER + i * BOOK_SECTION;
+        valid = get64(section + 8) + (uint64_t)get32(section + 4) * BOOK_ENTRY <= book->length;
+    }
+    if (!valid)
+    {
+        munmap(map, st.st_size);
+        close(fd);
+        free(book);
+        return NULL;
+    }
+    return book;
+}
+
+void closeBook(OpeningBook *book)
+{
+    if (book == NULL)
+        return;
+    munmap((void *)book->map, book->length);
+    close(book->fd);
+    free(book);
+}
+
+/* The entries of a board size.
+ *
+ * Returns:
+ *     A pointer into the mapping, NULL if the book has no such section.
+ */
+const unsigned char *bookSection(OpeningBook *book, int size, uint32_t *count)
+{
+    const unsigned char *section;
+    int i;
+    for (i = 0; i < book->sections; i++)
+    {
+        section = book->map + BOOK_HEADER + i * BOOK_SECTION;
+        if (section[0] == size)
+        {
+            *count = get32(section + 4);
+            return book->map + get64(section + 8);
+        }
+    }
+    return NULL;
+}
+
+/* Decode the entry at p */
+void bookRecord(const unsigned char *p, int size, BookRecord *record)
+{
+    record->size = size;
+    record->key = get64(p);
+    record->score = (int)get32(p + 8);
+    record->chain.from = (short)(p[12] | p[13] << 8);
+    record->chain.length = p[14];
+    memcpy(record->chain.dirs, p + 16, sizeof(record->chain.dirs));
+}
+
+/* Look a position up in the book.
+ *
+ * Returns:
+ *     1 with the chain filled in if the book has the position, 0
+ *     otherwise.
+ */
+int bookProbe(OpeningBook *book, int size, uint64_t key, Chain *chain)
+{
+    const unsigned char *entries;
+    BookRecord record;
+    uint32_t count, low = 0, high, mid;
+    uint64_t at;
+    int i;
+
+    entries = bookSection(book, size, &count);
+    if (entries == NULL)
+        return 0;
+    high = count;
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        at = get64(entries + (size_t)mid * BOOK_ENTRY);
+        if (at < key)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    if (low == count || get64(entries + (size_t)low * BOOK_ENTRY) != key)
+        return 0;
+    bookRecord(entries + (size_t)low * BOOK_ENTRY, size, &record);
+    if (record.chain.from < 0 || record.chain.length > TT_CHAIN_HOPS)
+        return 0;
+    chain->from = record.chain.from;
+    chain->length = record.chain.length;
+    chain->score = record.score;
+    for (i = 0; i < chain->length; i++)
+        chain->dirs[i] = (record.chain.dirs[i >> 2] >> ((i & 3) * 2)) & 3;
+    return 1;
+}
+
+/* Database of solved positions, made offline by --solve for small
+ * boards. The file is
+ *
+ *     header: "SKSD", version, board size, 2 reserved bytes, the slot
+ *         count (a power of two), the entry count, the longest probe
+ *         and 4 reserved bytes
+ *     slots: 24 bytes each: the positionKey, 0 for an empty slot, the
+ *         exact value of the position for the side to move, as
+ *         endgameSolve counts it, the from cell and length of the best
+ *         chain and its directions at 2 bits per hop
+ *
+ * A key lives in slot key & (slots - 1) or in one of the next `probe`
+ * slots, so a lookup reads a bounded run of the mapped file. Keys do not
+ * depend on the board size, a position of a small board is also one of
+ * the corner of a bigger board, so a database holds a single size and
+ * is only probed on boards of that size. Version 1 files did not record
+ * the size and are not read.
+ */
+#define SOLVED_MAGIC "SKSD"
+#define SOLVED_VERSION 2
+#define SOLVED_HEADER 32
+#define SOLVED_ENTRY 24
+
+typedef struct _SolvedDb {
+    int fd;
+    const unsigned char *map;
+    size_t length;
+    int size;
+    uint64_t slots;
+    uint64_t count;
+    uint32_t probe;
+} SolvedDb;
+
+/* Set with --solved */
+SolvedDb *solvedDb = NULL;
+
+/* Map a solved position database for reading.
+ *
+ * Returns:
+ *     The database, or NULL if the file cannot be mapped or is not a
+ *     valid database.
+ */
+SolvedDb *openSolvedDb(char *filename)
+{
+    SolvedDb *db;
+    struct stat st;
+    void *map;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < SOLVED_HEADER ||
+        (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+    db = (SolvedDb *)malloc(sizeof(SolvedDb));
+    db->fd = fd;
+    db->map = (const unsigned char *)map;
+    db->length = st.st_size;
+    db->size = db->map[5];
+    db->slots = get64(db->map + 8);
+    db->count = get64(db->map + 16);
+    db->probe = get32(db->map + 24);
+    if (memcmp(db->map, SOLVED_MAGIC, 4) != 0 || db->map[4] != SOLVED_VERSION || db->size < 4 ||
+        db->size > MAX_BOARD_SIZE || db->slots == 0 ||
+        (db->slots & (db->slots - 1)) != 0 || db->probe > db->slots ||
+        SOLVED_HEADER + db->slots * SOLVED_ENTRY != db->length)
+    {
+        munmap(map, st.st_size);
+        close(fd);
+        free(db);
+        return NULL;
+    }
+    return db;
+}
+
+void closeSolvedDb(SolvedDb *db)
+{
+    if (db == NULL)
+        return;
+    munmap((void *)db->map, db->length);
+    close(db->fd);
+    free(db);
+}
+
+/* Decode the slot at p */
+void solvedRecord(const unsigned char *p, SolvedRecord *record)
+{
+    record->key = get64(p);
+    record->value = (int)get32(p + 8);
+    record->from = (short)(p[12] | p[13] << 8);
+    record->length = p[14];
+    memcpy(record->dirs, p + 16, sizeof(record->dirs));
+}
+
+/* Look a position of a board of the given size up in the database.
+ *
+ * Returns:
+ *     1 with the best chain filled in, its score the exact value, if
+ *     the position is solved, 0 otherwise.
+ */
+int solvedProbe(SolvedDb *db, int size, uint64_t key, Chain *chain)
+{
+    const unsigned char *slot;
+    SolvedRecord record;
+    uint64_t at;
+    uint32_t n;
+    int i;
+
+    if (key == 0 || size != db->size)
+        return 0;
+    for (n = 0, at = key & (db->slots - 1); n <= db->probe; n++, at = (at + 1) & (db->slots - 1))
+    {
+        slot = db->map + SOLVED_HEADER + at * SOLVED_ENTRY;
+        if (get64(slot) == 0)
+            return 0;
+        if (get64(slot) != key)
+            continue;
+        solvedRecord(slot, &record);
+        if (record.from < 0 || record.length == 0 || record.length > SOLVED_CHAIN_HOPS)
+            return 0;
+        chain->from = record.from;
+        chain->length = record.length;
+        chain->score = record.value;
+        for (i = 0; i < chain->length; i++)
+            chain->dirs[i] = (record.dirs[i >> 2] >> ((i & 3) * 2)) & 3;
+        return 1;
+    }
+    return 0;
+}
+
+/* Choose the computer's chain for a turn: from the solved position
+ * database or the opening book when they have the position, from the
+ * endgame solver when few pieces are left, otherwise by the configured
+ * search.
+ */
+void computerChooseChain(Board *board, Player *player, Player *opponent, Chain *chain)
+{
+    SearchContext *ctx;
+
+    if (player->search == NULL)
+    {
+        player->search = createSearchContext(board->size);
+    }
+    ctx = player->search;
+    ctx->deadline = aiConfig.moveTimeMs ? monotonicMs() + aiConfig.moveTimeMs : 0;
+    if (solvedDb != NULL && solvedProbe(solvedDb, board->size, positionKey(board, player, opponent), chain) &&
+        isChainLegal(board, chain))
+    {
+        memset(&ctx->info, 0, sizeof(SearchInfo));
+        if (!headlessMode)
+            lastSearch = ctx->info;
+        return;
+    }
+    if (openingBook != NULL && bookProbe(openingBook, board->size, positionKey(board, player, opponent), chain) &&
+        isChainLegal(board, chain))
+    {
+        memset(&ctx->info, 0, sizeof(SearchInfo));
+        if (!headlessMode)
+            lastSearch = ctx->info;
+        return;
+    }
+    if (endgameBestChain(ctx, board, player, opponent, chain))
+    {
+        if (!headlessMode)
+            lastSearch = ctx->info;
+        return;
+    }
+    if (ctx->tt != NULL)
+        ttNewSearch(ctx->tt);
+
+    if (ctx->mode == AI_LAZYSMP)
+        searchBestChainLazySmp(ctx, board, player, opponent, chain);
+    else if (ctx->mode == AI_ALPHABETA && ctx->threads > 1)
+        searchBestChainParallel(ctx, board, player, opponent, chain);
+    else if (ctx->mode == AI_ALPHABETA)
+        searchBestChain(ctx, board, player, opponent, chain);
+    else
+        greedyBestChain(ctx, board, player, opponent, chain);
+    if (!headlessMode)
+        lastSearch = ctx->info;
+}
+
+int computerMakeMove(Board *board, Player *player, Player *opponent, char *outfile)
+{
+    /*
+     * Search every chain from every movable piece and play the best one
+     * in full.
+     */
+    Chain chain;
+
+    computerChooseChain(board, player, opponent, &chain);
+    if (chain.length == 0 || !playChain(board, player, &chain, outfile))
+    {
+        /* bot give up */
+        if (!headlessMode)
+            printError(board, "Computer cannot make a move\nGame Over!\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* A whole save file in memory: the starting board, both players, every
+ * move and the checkpoints between them, in either save format.
+ */
+typedef struct _SaveGame {
+    Board *board;
+    Player *players[2];
+    Move *moves;
+    /* byte offset of every move record in the file */
+    long *offsets;
+    int count;
+    int capacity;
+    Checkpoint *checkpoints;
+    int checkpointCount;
+} SaveGame;
+
+SaveGame *createSaveGame()
+{
+    SaveGame *game = (SaveGame *)calloc(1, sizeof(SaveGame));
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        game->players[i] = (Player *)calloc(1, sizeof(Player));
+        game->players[i]->id = i + 1;
+    }
+    return game;
+}
+
+void freeSaveGame(SaveGame *game)
+{
+    if (game == NULL)
+        return;
+    if (game->board != NULL)
+        freeBoard(game->board);
+    free(game->players[0]);
+    free(game->players[1]);
+    free(game->moves);
+    free(game->offsets);
+    free(game->checkpoints);
+    free(game);
+}
+
+void saveGameAddMove(SaveGame *game, Move move, long offset)
+{
+    if (game->count == game->capacity)
+    {
+        game->capacity = game->capacity ? game->capacity * 2 : 64;
+        game->moves = (Move *)realloc(game->moves, game->capacity * sizeof(Move));
+        game->offsets = (long *)realloc(game->offsets, game->capacity * sizeof(long));
+    }
+    move.next = NULL;
+    game->offsets[game->count] = offset;
+    game->moves[game->count++] = move;
+}
+
+/* Add a checkpoint at the current end of the moves */
+Checkpoint *saveGameAddCheckpoint(SaveGame *game)
+{
+    Checkpoint *checkpoint;
+    game->checkpoints = (Checkpoint *)realloc(game->checkpoints, (game->checkpointCount + 1) * sizeof(Checkpoint));
+    checkpoint = &game->checkpoints[game->checkpointCount++];
+    checkpoint->move = game->count;
+    return checkpoint;
+}
+
+/* Returns 1 if the file starts with the binary save magic */
+int isBinarySave(char *filename)
+{
+    char magic[4];
+    FILE *file = fopen(filename, "rb");
+    int binary;
+    if (file == NULL)
+        return 0;
+    binary = fread(magic, 1, 4, file) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0;
+    fclose(file);
+    return binary;
+}
+
+/* Single pass loader of text save files. The file is read in chunks
+ * of LOADER_CHUNK bytes, so its size does not matter, and every line is
+ * dispatched on its record type as it arrives: the size allocates the
+ * board, the board rows fill it, players are created, moves are checked
+ * and played, checkpoints replace the state. Unless the moves are
+ * collected, the loader jumps from the first move to the last
+ * checkpoint and reads only the file's head and tail.
+ */
+#define LOADER_CHUNK (1 << 16)
+
+typedef enum _LoadError {
+    LOAD_OK,
+    LOAD_NO_FILE,
+    LOAD_BAD_SIZE,
+    LOAD_BAD_BOARD,
+    LOAD_NO_PLAYER,
+    LOAD_INVALID_MOVE
+} LoadError;
+
+typedef struct _GameLoader {
+    Board *board;
+    Player *players[2];
+    /* player to move after the last record */
+    int next;
+    int moves;
+    /* byte offset of the record with the error, and the move for
+     * LOAD_INVALID_MOVE
+     */
+    long offset;
+    Move invalid;
+    LoadError error;
+    /* board rows still to come */
+    int rows;
+    /* when set, the starting board, moves and checkpoints go here too */
+    SaveGame *game;
+    /* only collect the moves into game, without playing them */
+    int collectOnly;
+} GameLoader;
+
+/* Read the integers of a line in order, skipping everything else */
+int parseInts(const char *line, int *values, int count)
+{
+    int n = 0, sign, value;
+    while (*line != '\0' && n < count)
+    {
+        if ((*line >= '0' && *line <= '9') || (*line == '-' && line[1] >= '0' && line[1] <= '9'))
+        {
+            sign = *line == '-' ? -1 : 1;
+            if (*line == '-')
+                line++;
+            for (value = 0; *line >= '0' && *line <= '9'; line++)
+                value = value * 10 + *line - '0';
+            values[n++] = sign * value;
+        }
+        else
+        {
+            line++;
+        }
+    }
+    return n;
+}
+
+/* Handle one line of a save file.
+ *
+ * Returns:
+ *     LOAD_OK, or the error that stops the load.
+ */
+LoadError loaderLine(GameLoader *loader, const char *line)
+{
+    Board *board = loader->board;
+    Player *player;
+    Checkpoint checkpoint;
+    Move move;
+    Piece c;
+    char name[JOURNAL_RECORD];
+    int values[4], i, j;
+
+    if (loader->rows > 0)
+    {
+        if ((int)strlen(line) < board->size)
+            return LOAD_BAD_BOARD;
+        i = board->size - loader->rows--;
+        for (j = 0; j < board->size; j++)
+            setCell(board, i, j, line[j] >= 'A' && line[j] <= 'E' ? line[j] : EMPTY);
+        if (loader->rows == 0)
+        {
+            computeBoardHash(board);
+            if (loader->game != NULL)
+                loader->game->board = copyBoard(board);
+        }
+        return LOAD_OK;
+    }
+
+    switch (line[0])
+    {
+    case 'm':
+        if (strncmp(line, "move:", 5) != 0 || parseInts(line, values, 4) != 4)
+            return LOAD_OK;
+        if (board == NULL)
+            return LOAD_BAD_SIZE;
+        move.playerId = values[0];
+        move.PieceX = values[1];
+        move.PieceY = values[2];
+        move.direction = values[3];
+        move.next = NULL;
+        if (loader->collectOnly)
+        {
+            loader->moves++;
+            saveGameAddMove(loader->game, move, loader->offset);
+            return LOAD_OK;
+        }
+        loader->invalid = move;
+        if (move.PieceX < 0 || move.PieceX >= board->size || move.PieceY < 0 || move.PieceY >= board->size ||
+            move.direction < UP || move.direction > RIGHT || (c = isMoveValid(board, &move)) == INVALID_PIECE)
+            return LOAD_INVALID_MOVE;
+        movePiece(board, &move);
+        for (i = 0; i < 2; i++)
+        {
+            if (loader->players[i] != NULL && loader->players[i]->id == move.playerId)
+                takePiece(loader->players[i], c);
+        }
+        loader->next = move.playerId == 2 ? 1 : 2;
+        loader->moves++;
+        if (loader->game != NULL)
+            saveGameAddMove(loader->game, move, loader->offset);
+        return LOAD_OK;
+    case 'p':
+        if (sscanf(line, "player: id: %d, type: %d, name: %s", &values[0], &values[1], name) != 3 ||
+            values[0] < 1 || values[0] > 2)
+            return LOAD_OK;
+        player = loader->players[values[0] - 1];
+        if (player == NULL)
+        {
+            player = (Player *)calloc(1, sizeof(Player));
+            loader->players[values[0] - 1] = player;
+        }
+        player->id = values[0];
+        player->type = values[1];
+        strncpy(player->name, name, 49);
+        player->name[49] = '\0';
+        return LOAD_OK;
+    case 's':
+        if (sscanf(line, "size: %d", &values[0]) != 1)
+            return LOAD_OK;
+        if (board != NULL || values[0] < 4 || values[0] > MAX_BOARD_SIZE)
+            return LOAD_BAD_SIZE;
+        loader->board = allocBoard(values[0]);
+        return LOAD_OK;
+    case 'b':
+        if (strncmp(line, "board:", 6) != 0)
+            return LOAD_OK;
+        if (board == NULL)
+            return LOAD_BAD_SIZE;
+        loader->rows = board->size;
+        return LOAD_OK;
+    case 'c':
+        if (board == NULL || !parseCheckpoint(line, board->size, &checkpoint))
+            return LOAD_OK;
+        if (loader->players[0] == NULL || loader->players[1] == NULL)
+            return LOAD_NO_PLAYER;
+        applyCheckpoint(&checkpoint, board, loader->players[0], loader->players[1]);
+        loader->next = checkpoint.next;
+        if (loader->game != NULL)
+        {
+            checkpoint.move = loader->game->count;
+            *saveGameAddCheckpoint(loader->game) = checkpoint;
+        }
+        return LOAD_OK;
+    }
+    return LOAD_OK;
+}
+
+/* Check that a load found everything a game needs */
+LoadError loaderFinish(GameLoader *loader)
+{
+    if (loader->error == LOAD_OK && (loader->board == NULL || loader->rows > 0))
+        loader->error = loader->board == NULL ? LOAD_BAD_SIZE : LOAD_BAD_BOARD;
+    if (loader->error == LOAD_OK && (loader->players[0] == NULL || loader->players[1] == NULL))
+        loader->error = LOAD_NO_PLAYER;
+    return loader->error;
+}
+
+/* Load a text save file in a single pass. On success the loader holds
+ * the board after the last move, both players with their pieces and
+ * scores, and the player to move. The loader owns the board and the
+ * players, freeLoader releases what the caller did not take.
+ *
+ * Returns:
+ *     LOAD_OK, or the error, with loader->offset set to its record.
+ */
+LoadError loadGame(char *filename, GameLoader *loader, SaveGame *game)
+{
+    char *chunk, line[JOURNAL_RECORD];
+    int fd, length = 0, i;
+    long offset = 0, skip;
+    ssize_t n;
+
+    memset(loader, 0, sizeof(GameLoader));
+    loader->next = 1;
+    loader->game = game;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return loader->error = LOAD_NO_FILE;
+    chunk = (char *)malloc(LOADER_CHUNK);
+    skip = game == NULL ? findLastCheckpoint(fd, LOADER_CHUNK) : -1;
+
+    while (loader->error == LOAD_OK && (n = read(fd, chunk, LOADER_CHUNK)) > 0)
+    {
+        for (i = 0; i < n && loader->error == LOAD_OK; i++)
+        {
+            if (chunk[i] != '\n')
+            {
+                /* longer lines are cut, no record is that long */
+                if (length < JOURNAL_RECORD - 1)
+                    line[length++] = chunk[i];
+                continue;
+            }
+            line[length] = '\0';
+            loader->offset = offset + i - length;
+            if (skip > offset + i - length && (line[0] == 'm' || line[0] == 'c') && loader->rows == 0)
+            {
+                if (loader->board != NULL && isCheckpointAt(fd, skip, loader->board->size))
+                {
+                    /* everything up to the last checkpoint is replaced by it */
+                    lseek(fd, skip, SEEK_SET);
+                    offset = skip;
+                    skip = -1;
+                    length = 0;
+                    break;
+                }
+                /* a torn checkpoint, replay every move instead */
+                skip = -1;
+            }
+            loader->error = loaderLine(loader, line);
+            length = 0;
+        }
+        if (i == n)
+            offset += n;
+    }
+    if (loader->error == LOAD_OK && length > 0)
+    {
+        line[length] = '\0';
+        loader->offset = offset - length;
+        loader->error = loaderLine(loader, line);
+    }
+    close(fd);
+    free(chunk);
+    return loaderFinish(loader);
+}
+
+/* Load a text save held in memory, like loadGame but without the jump
+ * to the last checkpoint. Without `play` the moves are only collected
+ * into the game, valid or not.
+ */
+LoadError loadGameBuffer(const char *data, size_t size, GameLoader *loader, SaveGame *game, int play)
+{
+    char line[JOURNAL_RECORD];
+    size_t i, start = 0, length;
+
+    memset(loader, 0, sizeof(GameLoader));
+    loader->next = 1;
+    loader->game = game;
+    loader->collectOnly = !play && game != NULL;
+    for (i = 0; i <= size && loader->error == LOAD_OK; i++)
+    {
+        if (i < size && data[i] != '\n')
+            continue;
+        length = i - start < JOURNAL_RECORD - 1 ? i - start : JOURNAL_RECORD - 1;
+        if (i < size || length > 0)
+        {
+            memcpy(line, data + start, length);
+            line[length] = '\0';
+            loader->offset = (long)start;
+            loader->error = loaderLine(loader, line);
+        }
+        start = i + 1;
+    }
+    return loaderFinish(loader);
+}
+
+void freeLoader(GameLoader *loader)
+{
+    if (loader->board != NULL)
+        freeBoard(loader->board);
+    free(loader->players[0]);
+    free(loader->players[1]);
+    memset(loader, 0, sizeof(GameLoader));
+}
+
+/* Print why a load failed */
+void printLoadError(char *filename, GameLoader *loader)
+{
+    switch (loader->error)
+    {
+    case LOAD_OK:
+        break;
+    case LOAD_NO_FILE:
+        printf("File not found\n");
+        break;
+    case LOAD_BAD_SIZE:
+        printf("Invalid board size\n");
+        break;
+    case LOAD_BAD_BOARD:
+        printf("%s: invalid board at byte %ld\n", filename, loader->offset);
+        break;
+    case LOAD_NO_PLAYER:
+        printf("%s: missing player\n", filename);
+        break;
+    case LOAD_INVALID_MOVE:
+        printf("%s: Invalid move at byte %ld, x: %d, y: %d, direction: %d\n", filename, loader->offset,
+               loader->invalid.PieceX, loader->invalid.PieceY, loader->invalid.direction);
+        break;
+    }
+}
+
+/* Move the players of a finished collecting load into its save game.
+ * The save game keeps the starting board, so they start from zero.
+ */
+SaveGame *loaderSaveGame(GameLoader *loader, SaveGame *game)
+{
+    int i;
+    for (i = 0; i < 2; i++)
+    {
+        free(game->players[i]);
+        game->players[i] = loader->players[i];
+        loader->players[i] = NULL;
+        game->players[i]->score = 0;
+        memset(game->players[i]->pieces, 0, sizeof(game->players[i]->pieces));
+    }
+    freeLoader(loader);
+    return game;
+}
+
+/* Read a text save file into a save game.
+ *
+ * Returns:
+ *     The game, or NULL with the reason printed if the file cannot be
+ *     loaded.
+ */
+SaveGame *readTextGame(char *filename)
+{
+    SaveGame *game = createSaveGame();
+    GameLoader loader;
+
+    if (loadGame(filename, &loader, game) != LOAD_OK)
+    {
+        printLoadError(filename, &loader);
+        freeLoader(&loader);
+        freeSaveGame(game);
+        return NULL;
+    }
+    return loaderSaveGame(&loader, game);
+}
+
+/* Decode a text save held in memory.
+ *
+ * Parameters:
+ *     play: check the moves by playing them, an invalid move makes the
+ *         whole save invalid.
+ *
+ * Returns:
+ *     The game, or NULL if the data is not a valid text save.
+ */
+SaveGame *decodeTextGame(const char *data, size_t length, int play)
+{
+    SaveGame *game = createSaveGame();
+    GameLoader loader;
+
+    if (loadGameBuffer(data, length, &loader, game, play) != LOAD_OK)
+    {
+        freeLoader(&loader);
+        freeSaveGame(game);
+        return NULL;
+    }
+    return loaderSaveGame(&loader, game);
+}
+
+/* Decode a binary save held in memory.
+ *
+ * Returns:
+ *     The game, or NULL if the data is not a valid binary save of a
+ *     known version or a move starts outside the board.
+ */
+SaveGame *decodeBinaryGame(const unsigned char *data, size_t length)
+{
+    SaveGame *game;
+    size_t at;
+    int size, players, i, k, nameLength;
+    unsigned value;
+    Move move;
+    Piece cells[MAX_CELLS];
+
+    if (length < BINARY_HEADER || memcmp(data, BINARY_MAGIC, 4) != 0 || data[4] < 1 || data[4] > BINARY_VERSION)
+        return NULL;
+    size = data[5];
+    players = data[6];
+    if (size < 4 || size > MAX_BOARD_SIZE || size % 2 != 0 || players != 2)
+        return NULL;
+    game = createSaveGame();
+    at = BINARY_HEADER;
+    for (i = 0; i < players; i++)
+    {
+        if (at + 3 > length || at + 3 + data[at + 2] > length)
+            break;
+        nameLength = data[at + 2] < 49 ? data[at + 2] : 49;
+        game->players[i]->id = data[at];
+        game->players[i]->type = data[at + 1];
+        memcpy(game->players[i]->name, data + at + 3, nameLength);
+        game->players[i]->name[nameLength] = '\0';
+        at += 3 + data[at + 2];
+    }
+    if (i < players || at + PACKED_BOARD(size) > length)
+    {
+        freeSaveGame(game);
+        return NULL;
+    }
+
+    game->board = allocBoard(size);
+    unpackCells(data + at, cells, size * size);
+    for (k = 0; k < size * size; k++)
+        setCell(game->board, k / size, k % size, cells[k]);
+    computeBoardHash(game->board);
+    at += PACKED_BOARD(size);
+
+    while (at + BINARY_MOVE <= length)
+    {
+        value = data[at] | data[at + 1] << 8;
+        if (value == BINARY_CHECKPOINT && data[4] >= 2)
+        {
+            if (at + CHECKPOINT_BYTES(size) > length)
+                break;
+            decodeCheckpoint(data + at, size, saveGameAddCheckpoint(game));
+            at += CHECKPOINT_BYTES(size);
+            continue;
+        }
+        /* 9 bits hold cells past the board, a move from one is corrupt */
+        if ((value & 0x1ff) >= (unsigned)(size * size))
+        {
+            freeSaveGame(game);
+            return NULL;
+        }
+        move.PieceX = (value & 0x1ff) / size;
+        move.PieceY = (value & 0x1ff) % size;
+        move.direction = value >> 9 & 3;
+        move.playerId = (value >> 11 & 1) + 1;
+        saveGameAddMove(game, move, (long)at);
+        at += BINARY_MOVE;
+    }
+    return game;
+}
+
+/* Read a binary save file in one go.
+ *
+ * Returns:
+ *     The game, or NULL if the file cannot be read or is not a valid
+ *     binary save of a known version.
+ */
+SaveGame *readBinaryGame(char *filename)
+{
+    SaveGame *game = NULL;
+    FILE *file;
+    unsigned char *data;
+    long length;
+
+    file = fopen(filename, "rb");
+    if (file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = (unsigned char *)malloc(length > 0 ? length : 1);
+    if (fread(data, 1, length, file) == (size_t)length)
+        game = decodeBinaryGame(data, length);
+    fclose(file);
+    free(data);
+    return game;
+}
+
+/* Write a game in the binary save format.
+ *
+ * Returns:
+ *     0 on success, 1 if the file cannot be written.
+ */
+int writeBinaryGame(char *filename, SaveGame *game)
+{
+    Board *board = game->board;
+    unsigned char *data = (unsigned char *)calloc(BINARY_HEADER + 2 * 52 + PACKED_BOARD(board->size) + game->count * BINARY_MOVE +
+                                                  game->checkpointCount * CHECKPOINT_BYTES(board->size), 1);
+    Piece cells[MAX_CELLS];
+    size_t at = 0;
+    int i, k, nameLength, written;
+    unsigned value;
+    FILE *file;
+
+    memcpy(data, BINARY_MAGIC, 4);
+    data[4] = BINARY_VERSION;
+    data[5] = board->size;
+    data[6] = 2;
+    at = BINARY_HEADER;
+    for (i = 0; i < 2; i++)
+    {
+        nameLength = (int)strlen(game->players[i]->name);
+        if (nameLength > 49)
+            nameLength = 49;
+        data[at] = game->players[i]->id;
+        data[at + 1] = game->players[i]->type;
+        data[at + 2] = nameLength;
+        memcpy(data + at + 3, game->players[i]->name, nameLength);
+        at += 3 + nameLength;
+    }
+
+    for (k = 0; k < board->size * board->size; k++)
+        cells[k] = board->cells[k / board->size][k % board->size];
+    packCells(data + at, cells, board->size * board->size);
+    at += PACKED_BOARD(board->size);
+
+    for (i = 0, k = 0; i <= game->count; i++)
+    {
+        for (; k < game->checkpointCount && game->checkpoints[k].move == i; k++)
+        {
+            encodeCheckpoint(data + at, board->size, &game->checkpoints[k]);
+            at += CHECKPOINT_BYTES(board->size);
+        }
+        if (i == game->count)
+            break;
+        value = (game->moves[i].PieceX * board->size + game->moves[i].PieceY) |
+                (unsigned)game->moves[i].direction << 9 | (unsigned)(game->moves[i].playerId - 1) << 11;
+        data[at++] = value & 0xff;
+        data[at++] = value >> 8;
+    }
+
+    file = fopen(filename, "wb");
+    if (file == NULL)
+    {
+        free(data);
+        return 1;
+    }
+    written = fwrite(data, 1, at, file) == at;
+    written = fclose(file) == 0 && written;
+    free(data);
+    return !written;
+}
+
+/* Write a game in the text save format */
+void writeTextGame(char *filename, SaveGame *game)
+{
+    int i, k = 0;
+    saveBoard(game->board, filename);
+    savePlayer(filename, game->players[0]);
+    savePlayer(filename, game->players[1]);
+    for (i = 0; i <= game->count; i++)
+    {
+        for (; k < game->checkpointCount && game->checkpoints[k].move == i; k++)
+            saveCheckpointRecord(filename, game->board->size, &game->checkpoints[k]);
+        if (i < game->count)
+            saveMove(filename, game->moves[i]);
+    }
+    journalClose();
+}
+
+/* Play the moves of a save game on the board and give the players their
+ * pieces, like loadMoves does. A game with checkpoints starts from the
+ * last one and plays only the moves after it.
+ *
+ * Returns:
+ *     -1 if every move is valid, otherwise the index of the first invalid
+ *     move; the moves before it are played.
+ */
+int replaySaveGame(SaveGame *game, Board *board, Player *player1, Player *player2, int *lastPlayerId)
+{
+    Checkpoint *checkpoint;
+    Move *move;
+    Piece c;
+    int i = 0, lastId = 2;
+
+    if (game->checkpointCount > 0)
+    {
+        checkpoint = &game->checkpoints[game->checkpointCount - 1];
+        applyCheckpoint(checkpoint, board, player1, player2);
+        i = checkpoint->move;
+        lastId = checkpoint->next == 1 ? 2 : 1;
+    }
+    for (; i < game->count; i++)
+    {
+        move = &game->moves[i];
+        if (move->PieceX < 0 || move->PieceX >= board->size || move->PieceY < 0 || move->PieceY >= board->size ||
+            move->direction < UP || move->direction > RIGHT || (c = isMoveValid(board, move)) == INVALID_PIECE)
+            return i;
+        movePiece(board, &game->moves[i]);
+        if (player1->id == game->moves[i].playerId)
+            player1->pieces[c - 'A']++;
+        else if (player2->id == game->moves[i].playerId)
+            player2->pieces[c - 'A']++;
+        lastId = game->moves[i].playerId;
+    }
+    *lastPlayerId = lastId == 2 ? 1 : 2;
+    return -1;
+}
+
+/* Convert a save file to the other format: a binary input is written as
+ * text and a text input as binary.
+ *
+ * Returns:
+ *     0 on success, 1 on error.
+ */
+int convertSave(char *input, char *output)
+{
+    SaveGame *game;
+    int binary = isBinarySave(input);
+
+    game = binary ? readBinaryGame(input) : readTextGame(input);
+    if (game == NULL)
+    {
+        /* the text reader has said why */
+        if (binary)
+            printf("Invalid save file: %s\n", input);
+        return 1;
+    }
+    if (binary)
+    {
+        writeTextGame(output, game);
+    }
+    else if (writeBinaryGame(output, game) != 0)
+    {
+        printf("Cannot write %s\n", output);
+        freeSaveGame(game);
+        return 1;
+    }
+    printf("%s: %d moves, written as %s to %s\n", input, game->count, binary ? "text" : "binary", output);
+    freeSaveGame(game);
+    return 0;
+}
+
+/* Archive of many games in one file. All numbers are little endian.
+ *
+ *     header: "SKPA", version, 3 reserved bytes, index offset (8 bytes)
+ *     games: the save files, text or binary, one after the other
+ *     index: game count, 4 reserved bytes, then one 32-byte entry per
+ *         game followed by the turn tables of all games
+ *
+ * An entry holds the game's offset (8 bytes), its length, moves, turns
+ * and the offset of its turn table from the start of the index (4 bytes
+ * each), its format (0 text, 1 binary), board size and 6 reserved bytes.
+ * A turn table has one 4-byte entry per turn: the offset of the turn's
+ * first move record from the start of the game.
+ *
+ * Readers map the whole file read-only, so any number of them can share
+ * it, and find a game or a turn through the index without scanning.
+ * Adding games appends them and a new index after the old one, syncs,
+ * and only then points the header at the new index with one 8-byte
+ * write, so a crash leaves the old archive intact and open readers never
+ * see a byte they use change. A new archive is written to a temporary
+ * file and renamed into place, and so is an archive that would become
+ * more than half old indexes: it is rewritten with only the live games
+ * and one index, which keeps its size linear in the games it holds.
+ */
+#define ARCHIVE_MAGIC "SKPA"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_HEADER 16
+#define ARCHIVE_ENTRY 32
+
+typedef struct _ArchiveEntry {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t moves;
+    uint32_t turns;
+    uint32_t turnTable;
+    int format;
+    int size;
+} ArchiveEntry;
+
+typedef struct _Archive {
+    int fd;
+    const unsigned char *map;
+    size_t length;
+    uint64_t indexOffset;
+    uint32_t count;
+} Archive;
+
+/* Map an archive for reading.
+ *
+ * Returns:
+ *     The archive, or NULL if the file cannot be mapped or is not a
+ *     valid archive.
+ */
+Archive *openArchive(char *filename)
+{
+    Archive *archive;
+    struct stat st;
+    void *map;
+    int fd = open(filename, O_RDONLY);
+
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size < ARCHIVE_HEADER + 8 ||
+        (map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return NULL;
+    }
+    archive = (Archive *)malloc(sizeof(Archive));
+    archive->fd = fd;
+    archive->map = (const unsigned char *)map;
+    archive->length = st.st_size;
+    archive->indexOffset = get64(archive->map + 8);
+    if (memcmp(archive->map, ARCHIVE_MAGIC, 4) != 0 || archive->map[4] != ARCHIVE_VERSION ||
+        archive->indexOffset + 8 > archive->length)
+    {
+        munmap(map, st.st_size);
+        close(fd);
+        free(archive);
+        return NULL;
+    }
+    archive->count = get32(archive->map + archive->indexOffset);
+    if (archive->indexOffset + 8 + (uint64_t)archive->count * ARCHIVE_ENTRY > archive->length)
+        archive->count = 0;
+    return archive;
+}
+
+void closeArchive(Archive *archive)
+{
+    if (archive == NULL)
+        return;
+    munmap((void *)archive->map, archive->length);
+    close(archive->fd);
+    free(archive);
+}
+
+/* Read the index entry of a game.
+ *
+ * Returns:
+ *     1 on success, 0 if there is no such game.
+ */
+int archiveEntry(Archive *archive, uint32_t id, ArchiveEntry *entry)
+{
+    const unsigned char *p;
+    if (id >= archive->count)
         return 0;
+    p = archive->map + archive->indexOffset + 8 + (uint64_t)id * ARCHIVE_ENTRY;
+    entry->offset = get64(p);
+    entry->length = get32(p + 8);
+    entry->moves = get32(p + 12);
+    entry->turns = get32(p + 16);
+    entry->turnTable = get32(p + 20);
+    entry->format = p[24];
+    entry->size = p[25];
+    return entry->offset + entry->length <= archive->indexOffset &&
+           archive->indexOffset + entry->turnTable + 4 * (uint64_t)entry->turns <= archive->length;
+}
+
+/* The bytes of a game, as its save file had them.
+ *
+ * Returns:
+ *     A pointer into the mapping, NULL if there is no such game.
+ */
+const unsigned char *archiveGame(Archive *archive, uint32_t id, size_t *length)
+{
+    ArchiveEntry entry;
+    if (!archiveEntry(archive, id, &entry))
+        return NULL;
+    *length = entry.length;
+    return archive->map + entry.offset;
+}
+
+/* The records of one turn of a game, from its first move record to the
+ * first move record of the next turn.
+ *
+ * Returns:
+ *     A pointer into the mapping, NULL if there is no such turn.
+ */
+const unsigned char *archiveTurn(Archive *archive, uint32_t id, uint32_t turn, size_t *length)
+{
+    ArchiveEntry entry;
+    const unsigned char *table;
+    uint32_t start, end;
+
+    if (!archiveEntry(archive, id, &entry) || turn >= entry.turns)
+        return NULL;
+    table = archive->map + archive->indexOffset + entry.turnTable;
+    start = get32(table + 4 * turn);
+    end = turn + 1 < entry.turns ? get32(table + 4 * (turn + 1)) : entry.length;
+    if (start > end || end > entry.length)
+        return NULL;
+    *length = end - start;
+    return archive->map + entry.offset + start;
+}
+
+/* Decode a game of the archive.
+ *
+ * Returns:
+ *     The game, or NULL if there is no such game or it is not valid.
+ */
+SaveGame *archiveSaveGame(Archive *archive, uint32_t id)
+{
+    ArchiveEntry entry;
+    if (!archiveEntry(archive, id, &entry))
+        return NULL;
+    if (entry.format == 1)
+        return decodeBinaryGame(archive->map + entry.offset, entry.length);
+    return decodeTextGame((const char *)archive->map + entry.offset, entry.length, 1);
+}
+
+/* Append save files to an archive, creating it if needed.
+ *
+ * Returns:
+ *     0 on success, 1 on error; on error the header still points to the
+ *     old index, so the archive holds the games it held before.
+ */
+int archiveAdd(char *filename, char **files, int count)
+{
+    Archive *archive = openArchive(filename);
+    unsigned char header[ARCHIVE_HEADER], *index, *entry, *data = NULL;
+    uint32_t total, turns, tables, at, i, t;
+    uint64_t offset, live = ARCHIVE_HEADER, added = 0;
+    ArchiveEntry old;
+    SaveGame **games;
+    FILE *file;
+    long length;
+    int fd, k, ok = 1, switched = 0, inPlace;
+    size_t indexLength;
+    char temp[512];
+    struct stat st;
+
+    if (archive == NULL && access(filename, F_OK) == 0)
+    {
+        printf("Not an archive: %s\n", filename);
+        return 1;
+    }
+
+    /* parse every game first, so a bad file changes nothing */
+    games = (SaveGame **)calloc(count, sizeof(SaveGame *));
+    tables = 0;
+    for (k = 0; k < count && ok; k++)
+    {
+        games[k] = isBinarySave(files[k]) ? readBinaryGame(files[k]) : readTextGame(files[k]);
+        if (games[k] == NULL)
+        {
+            printf("Invalid save file: %s\n", files[k]);
+            ok = 0;
+            break;
+        }
+        for (i = 0, turns = 0; i < (uint32_t)games[k]->count; i++)
+            turns += i == 0 || games[k]->moves[i].playerId != games[k]->moves[i - 1].playerId;
+        tables += turns;
+        if (stat(files[k], &st) == 0)
+            added += st.st_size;
+    }
+
+    total = (archive != NULL ? archive->count : 0) + count;
+    if (ok && archive != NULL)
+    {
+        for (i = 0; i < archive->count; i++)
+        {
+            if (archiveEntry(archive, i, &old))
+            {
+                tables += old.turns;
+                live += old.length;
+            }
+        }
+    }
+    indexLength = 8 + (size_t)total * ARCHIVE_ENTRY + (size_t)tables * 4;
+    index = (unsigned char *)calloc(indexLength, 1);
+    put32(index, total);
+    live += added + indexLength;
+    inPlace = archive != NULL && archive->length + added + indexLength <= 2 * live;
+    /* behind everything a reader of the old index may use */
+    offset = inPlace ? archive->length : ARCHIVE_HEADER;
+    at = 8 + total * ARCHIVE_ENTRY;
+
+    /* the entries and turn tables of the games already there */
+    for (i = 0; ok && archive != NULL && i < archive->count; i++)
+    {
+        archiveEntry(archive, i, &old);
+        entry = index + 8 + i * ARCHIVE_ENTRY;
+        memcpy(entry, archive->map + archive->indexOffset + 8 + (uint64_t)i * ARCHIVE_ENTRY, ARCHIVE_ENTRY);
+        put32(entry + 20, at);
+        memcpy(index + at, archive->map + archive->indexOffset + old.turnTable, 4 * old.turns);
+        at += 4 * old.turns;
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp", filename);
+    fd = !ok ? -1 : inPlace ? open(filename, O_RDWR) : open(temp, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (ok && fd < 0)
+    {
+        printf("Cannot write %s\n", filename);
+        ok = 0;
+    }
+    /* a rewrite copies the games already there first */
+    for (i = 0; ok && !inPlace && archive != NULL && i < archive->count; i++)
+    {
+        entry = index + 8 + i * ARCHIVE_ENTRY;
+        length = get32(entry + 8);
+        ok = get64(entry) + length <= archive->length &&
+             pwrite(fd, archive->map + get64(entry), length, offset) == length;
+        put64(entry, offset);
+        offset += length;
+    }
+    for (k = 0; ok && k < count; k++)
+    {
+        file = fopen(files[k], "rb");
+        fseek(file, 0, SEEK_END);
+        length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data = (unsigned char *)realloc(data, length > 0 ? length : 1);
+        ok = fread(data, 1, length, file) == (size_t)length;
+        fclose(file);
+        ok = ok && pwrite(fd, data, length, offset) == length;
+
+        entry = index + 8 + ((archive != NULL ? archive->count : 0) + k) * ARCHIVE_ENTRY;
+        put64(entry, offset);
+        put32(entry + 8, (uint32_t)length);
+        put32(entry + 12, games[k]->count);
+        put32(entry + 20, at);
+        entry[24] = isBinarySave(files[k]);
+        entry[25] = games[k]->board->size;
+        for (i = 0, t = 0; i < (uint32_t)games[k]->count; i++)
+        {
+            if (i == 0 || games[k]->moves[i].playerId != games[k]->moves[i - 1].playerId)
+            {
+                put32(index + at, (uint32_t)games[k]->offsets[i]);
+                at += 4;
+                t++;
+            }
+        }
+        put32(entry + 16, t);
+        offset += length;
+    }
+
+    if (ok)
+    {
+        memset(header, 0, sizeof(header));
+        memcpy(header, ARCHIVE_MAGIC, 4);
+        header[4] = ARCHIVE_VERSION;
+        put64(header + 8, offset);
+        ok = pwrite(fd, index, indexLength, offset) == (ssize_t)indexLength && fsync(fd) == 0;
+        if (ok && inPlace)
+        {
+            switched = pwrite(fd, header + 8, 8, 8) == 8;
+            ok = switched && fsync(fd) == 0;
+        }
+        else if (ok)
+            ok = pwrite(fd, header, ARCHIVE_HEADER, 0) == ARCHIVE_HEADER && fsync(fd) == 0 &&
+                 rename(temp, filename) == 0;
+    }
+    if (fd >= 0 && !ok)
+    {
+        printf("Cannot write %s\n", filename);
+        /* drop what was appended while the header still points before it */
+        if (inPlace && !switched && ftruncate(fd, archive->length) != 0)
+            printf("Cannot truncate %s\n", filename);
+        else if (!inPlace)
+            remove(temp);
+    }
+    if (fd >= 0)
+        close(fd);
+    closeArchive(archive);
+    for (k = 0; k < count; k++)
+        freeSaveGame(games[k]);
+    free(games);
+    free(index);
+    free(data);
+    return !ok;
+}
+
+/* Archive command line.
+ *
+ *     add ARCHIVE FILE...: append save files
+ *     list ARCHIVE: print the index
+ *     get ARCHIVE ID: print a game as it was saved
+ *     turn ARCHIVE ID TURN: print the moves of a turn of a game
+ */
+int runArchive(int argc, char **argv)
+{
+    Archive *archive;
+    ArchiveEntry entry;
+    const unsigned char *data;
+    size_t length, at, next;
+    uint32_t i;
+    unsigned value;
+
+    if (argc >= 2 && strcmp(argv[0], "add") == 0)
+        return argc < 3 ? 1 : archiveAdd(argv[1], argv + 2, argc - 2);
+    if (argc < 2)
+        return 1;
+    archive = openArchive(argv[1]);
+    if (archive == NULL)
+    {
+        printf("Cannot open archive %s\n", argv[1]);
+        return 1;
+    }
+
+    if (strcmp(argv[0], "list") == 0)
+    {
+        printf("id,format,size,moves,turns,offset,length\n");
+        for (i = 0; i < archive->count; i++)
+        {
+            if (archiveEntry(archive, i, &entry))
+                printf("%u,%s,%d,%u,%u,%lu,%u\n", i, entry.format ? "binary" : "text", entry.size, entry.moves,
+                       entry.turns, (unsigned long)entry.offset, entry.length);
+        }
+    }
+    else if (strcmp(argv[0], "get") == 0 && argc == 3 && (data = archiveGame(archive, atoi(argv[2]), &length)) != NULL)
+    {
+        fflush(stdout);
+        for (at = 0; at < length;)
+        {
+            ssize_t n = write(STDOUT_FILENO, data + at, length - at);
+            if (n <= 0)
+                break;
+            at += n;
+        }
+    }
+    else if (strcmp(argv[0], "turn") == 0 && argc == 4 && archiveEntry(archive, atoi(argv[2]), &entry) &&
+             (data = archiveTurn(archive, atoi(argv[2]), atoi(argv[3]), &length)) != NULL)
+    {
+        if (entry.format == 0)
+        {
+            /* only the move lines, a checkpoint may follow the turn */
+            for (at = 0; at < length; at = next + 1)
+            {
+                for (next = at; next < length && data[next] != '\n'; next++)
+                    ;
+                if (next - at > 5 && memcmp(data + at, "move:", 5) == 0)
+                    printf("%.*s\n", (int)(next - at), (const char *)data + at);
+            }
+        }
+        else
+        {
+            for (at = 0; at + BINARY_MOVE <= length; at += BINARY_MOVE)
+            {
+                value = data[at] | data[at + 1] << 8;
+                if (value == BINARY_CHECKPOINT)
+                {
+                    at += CHECKPOINT_BYTES(entry.size) - BINARY_MOVE;
+                    continue;
+                }
+                printf("move: player: %d, x: %d, y: %d, direction: %d\n", (value >> 11 & 1) + 1,
+                       (value & 0x1ff) / entry.size, (value & 0x1ff) % entry.size, value >> 9 & 3);
+            }
+        }
+    }
+    else
+    {
+        printf("No such game or turn\n");
+        closeArchive(archive);
+        return 1;
+    }
+    closeArchive(archive);
+    return 0;
+}
+
+/* Free a player and its search memory */
+void freePlayer(Player *player)
+{
+    freeSearchContext(player->search);
+    free(player);
+}
+
+/* Parse the command line options.
+ *
+ * Options:
+ *     --tt N: number of transposition table entries for the computer
+ *     --ai greedy|alphabeta|lazysmp: search mode of the computer
+ *     --depth N: deepest alpha-beta iteration, in chains
+ *     --time MS: alpha-beta time budget per computer move
+ *     --threads N: search threads of the alpha-beta computer
+ *     --sync turn|exit|N: when the save file is written, after every
+ *         turn, only at exit, or every N turns
+ *     --async-save: write the save file from a background thread
+ *     --checkpoint N: turns between two checkpoints in the save file,
+ *         0 for none
+ *     --book FILE: opening book the computer looks positions up in
+ *     --solved FILE: solved position database, looked up before the book
+ *         on boards of its size
+ *     --seed N: make a new game's board from a seed instead of at random
+ *     --endgame N: solve the game exactly once at most N pieces are
+ *         left, 0 to never
+ *
+ * Returns:
+ *     0 on success, 1 on an unknown or malformed option.
+ */
+int parseOptions(int argc, char **argv)
+{
+    int i;
+    for (i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--tt") == 0 && i + 1 < argc)
+        {
+            aiConfig.ttEntries = (size_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--ai") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "greedy") == 0)
+                aiConfig.mode = AI_GREEDY;
+            else if (strcmp(argv[i], "alphabeta") == 0)
+                aiConfig.mode = AI_ALPHABETA;
+            else if (strcmp(argv[i], "lazysmp") == 0)
+                aiConfig.mode = AI_LAZYSMP;
+            else
+            {
+                printf("Unknown search mode: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc)
+        {
+            aiConfig.moveTimeMs = (unsigned)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            aiConfig.threads = atoi(argv[++i]);
+            if (aiConfig.threads < 1 || aiConfig.threads > MAX_THREADS)
+            {
+                printf("Threads must be between 1 and %d\n", MAX_THREADS);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--sync") == 0 && i + 1 < argc)
+        {
+            i++;
+            if (strcmp(argv[i], "turn") == 0)
+                journal.sync = SYNC_TURN;
+            else if (strcmp(argv[i], "exit") == 0)
+                journal.sync = SYNC_EXIT;
+            else if (atoi(argv[i]) > 0)
+            {
+                journal.sync = SYNC_EVERY;
+                journal.every = atoi(argv[i]);
+            }
+            else
+            {
+                printf("Unknown sync mode: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--checkpoint") == 0 && i + 1 < argc)
+        {
+            journal.checkpointEvery = atoi(argv[++i]);
+            if (journal.checkpointEvery < 0)
+            {
+                printf("Checkpoint interval must not be negative\n");
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--async-save") == 0)
+        {
+            journal.async = 1;
+        }
+        else if (strcmp(argv[i], "--book") == 0 && i + 1 < argc)
+        {
+            i++;
+            closeBook(openingBook);
+            openingBook = openBook(argv[i]);
+            if (openingBook == NULL)
+            {
+                printf("Cannot open opening book: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--endgame") == 0 && i + 1 < argc)
+        {
+            aiConfig.endgamePieces = atoi(argv[++i]);
+            if (aiConfig.endgamePieces < 0 || aiConfig.endgamePieces > ENDGAME_MAX_PIECES)
+            {
+                printf("Endgame pieces must be between 0 and %d\n", ENDGAME_MAX_PIECES);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--solved") == 0 && i + 1 < argc)
+        {
+            i++;
+            closeSolvedDb(solvedDb);
+            solvedDb = openSolvedDb(argv[i]);
+            if (solvedDb == NULL)
+            {
+                printf("Cannot open solved position database: %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        {
+            boardSeeded = 1;
+            boardSeed = (uint64_t)strtoul(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+        {
+            aiConfig.maxDepth = atoi(argv[++i]);
+            if (aiConfig.maxDepth < 1 || aiConfig.maxDepth >= SEARCH_MAX_PLY)
+            {
+                printf("Depth must be between 1 and %d\n", SEARCH_MAX_PLY - 1);
+                return 1;
+            }
+        }
+        else
+        {
+            printf("Unknown option: %s\n", argv[i]);
+            return 1;
+        }
     }
+    return 0;
+}
 
-    /* get coordinates */ 
-    printControl(board, COLOR_BOLD "%s" COLOR_RESET " make your move: ", player->name);
-    scanf(" %c", &xaxis);
-    if (xaxis == 'q')
+/* Make a move for the player
+ *
+ * Parameters:
+ * - board: the game board
+ * - player: the player who will make the move
+ * Returns:
+ * - the move made by the player
+*/
+int playerMakeMove(Board *board, Player *player, Player *opponent, char *outfile)
+{
+    if (player->type == HUMAN)
+        return humanMakeMove(board, player, opponent, outfile);
+    else
+        return computerMakeMove(board, player, opponent, outfile);
+}
+
+/* Play the game until a player cannot or does not want to move.
+ *
+ * Returns:
+ *     The number of turns played.
+ */
+int GameLoop(Board *board, Player *player1, Player *player2, char *outfile, int idx)
+{
+    int isGameRunning = 1;
+    int turns = 0;
+    Player* currentPlayer;
+    Player* nextPlayer;
+    Player* tmp;
+
+    if (idx == 1)
     {
-        return 0;
+        currentPlayer = player1;
+        nextPlayer = player2;
     }
-    scanf(" %c", &yaxis);
-    if (xaxis > '0' && xaxis <= '9')
+    else
     {
-        x = xaxis - '0' - 1;
+        currentPlayer = player2;
+        nextPlayer = player1;
     }
-    else if (xaxis >= 'A' && xaxis <= 'Z')
+
+    /* size the computer players' search memory once for the game */
+    if (player1->type == COMPUTER && player1->search == NULL)
+        player1->search = createSearchContext(board->size);
+    if (player2->type == COMPUTER && player2->search == NULL)
+        player2->search = createSearchContext(board->size);
+
+    /* a new game starts from a fresh screen; headless games share no
+     * screen, and run on several threads in self-play
+     */
+    if (!headlessMode)
     {
-        x = xaxis - 'A' + 9;
+        screen.valid = 0;
+        render(board, player1, player2);
     }
-    else if (xaxis >= 'a' && xaxis <= 'z')
+    while (isGameRunning)
     {
-        x = xaxis - 'a' + 9;
+        if (playerMakeMove(board, currentPlayer, nextPlayer, outfile) == 0)
+        {
+            isGameRunning = 0;
+        }
+        else
+        {
+            turns++;
+        }
+        tmp = currentPlayer;
+        currentPlayer = nextPlayer;
+        nextPlayer = tmp;
+        if (outfile != NULL)
+        {
+            if (isGameRunning && journal.checkpointEvery > 0 && turns % journal.checkpointEvery == 0)
+                saveCheckpoint(outfile, board, player1, player2, currentPlayer->id);
+            journalEndTurn();
+        }
+
+        if (!headlessMode)
+            render(board, player1, player2);
+    }
+    /* the save file is complete */
+    if (outfile != NULL)
+        journalClose();
+    return turns;
+}
+
+/* Create a player with empty pieces */
+Player *createPlayer(int id, PlayerType type, char *name)
+{
+    Player *player = (Player *)malloc(sizeof(Player));
+    int i;
+    player->id = id;
+    player->type = type;
+    strncpy(player->name, name, 50);
+    player->name[49] = '\0';
+    player->score = 0;
+    for (i = 0; i < 5; i++)
+    {
+        player->pieces[i] = 0;
     }
+    player->search = NULL;
+    return player;
+}
 
-    if (yaxis > '0' && yaxis <= '9')
+/* Play games given[next], ... of a self-play run until none are left */
+void *selfPlayWorker(void *arg)
+{
+    SelfPlay *run = (SelfPlay *)arg;
+    SelfPlayResult *result;
+    Player *player1, *player2;
+    Board *board;
+    int game;
+
+    while ((game = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) < run->games)
     {
-        y = yaxis - '0' - 1;
+        result = &run->results[game];
+        board = initBoardSeeded(run->size, run->seed + (uint64_t)game);
+        player1 = createPlayer(1, COMPUTER, "Computer1");
+        player2 = createPlayer(2, COMPUTER, "Computer2");
+        /* alternate who starts */
+        result->turns = GameLoop(board, player1, player2, NULL, 1 + game % 2);
+        result->score[0] = player1->score;
+        result->score[1] = player2->score;
+        freeBoard(board);
+        freePlayer(player1);
+        freePlayer(player2);
     }
-    else if (yaxis >= 'A' && yaxis <= 'Z')
+    return NULL;
+}
+
+/* Run computer vs computer games without any terminal output and print
+ * aggregate results. Game i uses board seed + i, so a run can be
+ * repeated exactly.
+ *
+ * Parameters:
+ *     size: board size
+ *     seed: seed of the first game
+ *     games: number of games
+ *     threads: games played in parallel
+ */
+int runSelfPlay(int size, uint64_t seed, int games, int threads)
+{
+    SelfPlay run;
+    pthread_t *workers;
+    pthread_attr_t attr;
+    uint64_t start, elapsed;
+    long turns = 0, score[2] = { 0, 0 };
+    int wins[2] = { 0, 0 }, draws = 0;
+    int i;
+
+    if (size % 2 != 0 || size < 4 || size > MAX_BOARD_SIZE || games < 1 || threads < 1 || threads > MAX_THREADS)
+    {
+        printf("Invalid self-play parameters\n");
+        return 1;
+    }
+
+    run.size = size;
+    run.seed = seed;
+    run.games = games;
+    run.next = 0;
+    run.results = (SelfPlayResult *)calloc(games, sizeof(SelfPlayResult));
+    workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    headlessMode = 1;
+    initZobrist();
+
+    start = monotonicMs();
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK);
+    for (i = 0; i < threads; i++)
+        pthread_create(&workers[i], &attr, selfPlayWorker, &run);
+    for (i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+    pthread_attr_destroy(&attr);
+    elapsed = monotonicMs() - start;
+
+    for (i = 0; i < games; i++)
+    {
+        turns += run.results[i].turns;
+        score[0] += run.results[i].score[0];
+        score[1] += run.results[i].score[1];
+        if (run.results[i].score[0] > run.results[i].score[1])
+            wins[0]++;
+        else if (run.results[i].score[0] < run.results[i].score[1])
+            wins[1]++;
+        else
+            draws++;
+    }
+
+    printf("games: %d\n", games);
+    printf("size: %d\n", size);
+    printf("seed: %lu\n", (unsigned long)seed);
+    printf("threads: %d\n", threads);
+    printf("player1 win rate: %.3f\n", (double)wins[0] / games);
+    printf("player2 win rate: %.3f\n", (double)wins[1] / games);
+    printf("draw rate: %.3f\n", (double)draws / games);
+    printf("player1 average score: %.2f\n", (double)score[0] / games);
+    printf("player2 average score: %.2f\n", (double)score[1] / games);
+    printf("average game length: %.2f turns\n", (double)turns / games);
+    printf("elapsed: %lu ms\n", (unsigned long)elapsed);
+    printf("turns per second: %.1f\n", elapsed ? turns * 1000.0 / elapsed : 0.0);
+
+    free(run.results);
+    free(workers);
+    return 0;
+}
+
+/* Batch analysis of saved games. Every game is replayed from its
+ * starting board with the rules of loadMoves, so a game that loadMoves
+ * would stop at is reported with its first invalid move instead, and
+ * the games are shared by a pool of workers like a self-play run.
+ */
+#define ANALYSIS_CHAINS 16
+
+typedef enum _AnalysisStatus {
+    ANALYSIS_OK,
+    ANALYSIS_UNREADABLE,
+    ANALYSIS_INVALID
+} AnalysisStatus;
+
+/* Result of one analyzed game */
+typedef struct _AnalysisResult {
+    AnalysisStatus status;
+    int moves;
+    int turns;
+    /* the first invalid move and its index */
+    int invalidIndex;
+    Move invalid;
+    int score[2];
+    /* turns by number of moves, the last one counts ANALYSIS_CHAINS or more */
+    int chains[ANALYSIS_CHAINS + 1];
+    /* pieces A-E taken by each player */
+    int captures[2][5];
+} AnalysisResult;
+
+/* An analysis run shared by its worker threads, over either save files
+ * or the games of an archive
+ */
+typedef struct _Analysis {
+    char **files;
+    Archive *archive;
+    int games;
+    int next;
+    AnalysisResult *results;
+} Analysis;
+
+/* Read and decode game `id` of an analysis. Text moves are only
+ * collected, so that the replay finds an invalid one.
+ *
+ * Returns:
+ *     The game, or NULL if it cannot be read.
+ */
+SaveGame *analysisGame(Analysis *run, int id)
+{
+    SaveGame *game = NULL;
+    ArchiveEntry entry;
+    FILE *file;
+    unsigned char *data;
+    long length;
+
+    if (run->archive != NULL)
+    {
+        if (!archiveEntry(run->archive, id, &entry))
+            return NULL;
+        if (entry.format == 1)
+            return decodeBinaryGame(run->archive->map + entry.offset, entry.length);
+        return decodeTextGame((const char *)run->archive->map + entry.offset, entry.length, 0);
+    }
+
+    file = fopen(run->files[id], "rb");
+    if (file == NULL)
+        return NULL;
+    fseek(file, 0, SEEK_END);
+    length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = (unsigned char *)malloc(length > 0 ? length : 1);
+    if (fread(data, 1, length, file) == (size_t)length)
+    {
+        if (length >= 4 && memcmp(data, BINARY_MAGIC, 4) == 0)
+            game = decodeBinaryGame(data, length);
+        else
+            game = decodeTextGame((const char *)data, length, 0);
+    }
+    fclose(file);
+    free(data);
+    return game;
+}
+
+/* Replay a game from its starting board and collect its statistics */
+void analyzeGame(SaveGame *game, AnalysisResult *result)
+{
+    Board *board = copyBoard(game->board);
+    Player players[2];
+    Move *move;
+    Piece c;
+    int i, k, chain = 0;
+
+    memset(players, 0, sizeof(players));
+    for (k = 0; k < 2; k++)
+        players[k].id = game->players[k]->id;
+    result->status = ANALYSIS_OK;
+    for (i = 0; i < game->count; i++)
+    {
+        move = &game->moves[i];
+        move->next = NULL;
+        if (move->PieceX < 0 || move->PieceX >= board->size || move->PieceY < 0 || move->PieceY >= board->size ||
+            move->direction < UP || move->direction > RIGHT || (c = isMoveValid(board, move)) == INVALID_PIECE)
+        {
+            result->status = ANALYSIS_INVALID;
+            result->invalidIndex = i;
+            result->invalid = *move;
+            break;
+        }
+        movePiece(board, move);
+        for (k = 0; k < 2; k++)
+        {
+            if (players[k].id == move->playerId)
+            {
+                takePiece(&players[k], c);
+                result->captures[k][c - 'A']++;
+            }
+        }
+        /* a turn is the run of moves by one player */
+        if (i > 0 && move->playerId != game->moves[i - 1].playerId)
+        {
+            result->chains[chain < ANALYSIS_CHAINS ? chain : ANALYSIS_CHAINS]++;
+            chain = 0;
+        }
+        chain++;
+    }
+    if (chain > 0)
+        result->chains[chain < ANALYSIS_CHAINS ? chain : ANALYSIS_CHAINS]++;
+    result->moves = i;
+    for (k = 1; k <= ANALYSIS_CHAINS; k++)
+        result->turns += result->chains[k];
+    result->score[0] = players[0].score;
+    result->score[1] = players[1].score;
+    freeBoard(board);
+}
+
+/* Analyze games given[next], ... of an analysis run until none are left */
+void *analysisWorker(void *arg)
+{
+    Analysis *run = (Analysis *)arg;
+    SaveGame *game;
+    int id;
+
+    while ((id = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) < run->games)
+    {
+        game = analysisGame(run, id);
+        if (game == NULL || game->board == NULL)
+            run->results[id].status = ANALYSIS_UNREADABLE;
+        else
+            analyzeGame(game, &run->results[id]);
+        if (game != NULL)
+            freeSaveGame(game);
+    }
+    return NULL;
+}
+
+int compareNames(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* List the regular files of a directory, sorted by name.
+ *
+ * Returns:
+ *     The paths, NULL if the directory cannot be read.
+ */
+char **listSaveFiles(char *path, int *count)
+{
+    DIR *dir = opendir(path);
+    struct dirent *ent;
+    struct stat st;
+    char **files = NULL;
+    int capacity = 0;
+    size_t length;
+
+    *count = 0;
+    if (dir == NULL)
+        return NULL;
+    while ((ent = readdir(dir)) != NULL)
+    {
+        if (ent->d_name[0] == '.')
+            continue;
+        if (*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            files = (char **)realloc(files, capacity * sizeof(char *));
+        }
+        length = strlen(path) + strlen(ent->d_name) + 2;
+        files[*count] = (char *)malloc(length);
+        snprintf(files[*count], length, "%s/%s", path, ent->d_name);
+        if (stat(files[*count], &st) == 0 && S_ISREG(st.st_mode))
+            (*count)++;
+        else
+            free(files[*count]);
+    }
+    closedir(dir);
+    if (*count > 0)
+        qsort(files, *count, sizeof(char *), compareNames);
+    return files != NULL ? files : (char **)malloc(sizeof(char *));
+}
+
+/* Replay every game of a directory of save files, an archive or a
+ * single save file and print aggregate statistics. Nothing here exits:
+ * unreadable games and games with an invalid move are counted and
+ * listed, and the rest of the batch goes on.
+ *
+ * Parameters:
+ *     path: directory, archive or save file
+ *     threads: games analyzed in parallel
+ */
+int runAnalysis(char *path, int threads)
+{
+    Analysis run;
+    AnalysisResult *result;
+    pthread_t *workers;
+    pthread_attr_t attr;
+    struct stat st;
+    uint64_t start, elapsed;
+    long moves = 0, turns = 0, score[2] = { 0, 0 }, captures[2][5], chains[ANALYSIS_CHAINS + 1];
+    long taken[2] = { 0, 0 };
+    int wins[2] = { 0, 0 }, draws = 0, unreadable = 0, invalid = 0, valid;
+    int i, k;
+
+    if (threads < 1 || threads > MAX_THREADS || stat(path, &st) != 0)
+    {
+        printf("Invalid analysis parameters\n");
+        return 1;
+    }
+
+    memset(&run, 0, sizeof(run));
+    if (S_ISDIR(st.st_mode))
+    {
+        run.files = listSaveFiles(path, &run.games);
+        if (run.files == NULL)
+        {
+            printf("Cannot read directory %s\n", path);
+            return 1;
+        }
+    }
+    else if ((run.archive = openArchive(path)) != NULL)
+    {
+        run.games = run.archive->count;
+    }
+    else
+    {
+        run.files = (char **)malloc(sizeof(char *));
+        run.files[0] = strdup(path);
+        run.games = 1;
+    }
+    run.results = (AnalysisResult *)calloc(run.games > 0 ? run.games : 1, sizeof(AnalysisResult));
+    workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    headlessMode = 1;
+    initZobrist();
+
+    start = monotonicMs();
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK);
+    for (i = 0; i < threads; i++)
+        pthread_create(&workers[i], &attr, analysisWorker, &run);
+    for (i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+    pthread_attr_destroy(&attr);
+    elapsed = monotonicMs() - start;
+
+    memset(captures, 0, sizeof(captures));
+    memset(chains, 0, sizeof(chains));
+    for (i = 0; i < run.games; i++)
+    {
+        result = &run.results[i];
+        if (result->status == ANALYSIS_UNREADABLE)
+        {
+            unreadable++;
+            continue;
+        }
+        if (result->status == ANALYSIS_INVALID)
+            invalid++;
+        moves += result->moves;
+        turns += result->turns;
+        for (k = 1; k <= ANALYSIS_CHAINS; k++)
+            chains[k] += result->chains[k];
+        for (k = 0; k < 5; k++)
+        {
+            captures[0][k] += result->captures[0][k];
+            captures[1][k] += result->captures[1][k];
+            taken[0] += result->captures[0][k];
+            taken[1] += result->captures[1][k];
+        }
+        if (result->status != ANALYSIS_OK)
+            continue;
+        score[0] += result->score[0];
+        score[1] += result->score[1];
+        if (result->score[0] > result->score[1])
+            wins[0]++;
+        else if (result->score[0] < result->score[1])
+            wins[1]++;
+        else
+            draws++;
+    }
+    valid = run.games - unreadable - invalid;
+
+    printf("games: %d\n", run.games);
+    printf("threads: %d\n", threads);
+    printf("unreadable games: %d\n", unreadable);
+    printf("games with an invalid move: %d\n", invalid);
+    for (i = 0; i < run.games; i++)
+    {
+        result = &run.results[i];
+        if (result->status == ANALYSIS_OK)
+            continue;
+        if (run.files != NULL)
+            printf("%s: ", run.files[i]);
+        else
+            printf("game %d: ", i);
+        if (result->status == ANALYSIS_UNREADABLE)
+            printf("unreadable\n");
+        else if (result->status == ANALYSIS_INVALID)
+            printf("invalid move %d, player: %d, x: %d, y: %d, direction: %d\n", result->invalidIndex + 1,
+                   result->invalid.playerId, result->invalid.PieceX, result->invalid.PieceY,
+                   result->invalid.direction);
+    }
+    if (valid > 0)
+    {
+        printf("player1 win rate: %.3f\n", (double)wins[0] / valid);
+        printf("player2 win rate: %.3f\n", (double)wins[1] / valid);
+        printf("draw rate: %.3f\n", (double)draws / valid);
+        printf("player1 average score: %.2f\n", (double)score[0] / valid);
+        printf("player2 average score: %.2f\n", (double)score[1] / valid);
+    }
+    printf("moves: %ld\n", moves);
+    printf("turns: %ld\n", turns);
+    printf("average chain length: %.2f\n", turns ? (double)moves / turns : 0.0);
+    for (k = 1; k <= ANALYSIS_CHAINS; k++)
+    {
+        if (chains[k] > 0)
+            printf("chain length %d%s: %ld (%.3f)\n", k, k == ANALYSIS_CHAINS ? "+" : "", chains[k],
+                   (double)chains[k] / turns);
+    }
+    for (i = 0; i < 2; i++)
+    {
+        for (k = 0; k < 5; k++)
+            printf("player%d captures %c: %ld (%.3f)\n", i + 1, 'A' + k, captures[i][k],
+                   taken[i] ? (double)captures[i][k] / taken[i] : 0.0);
+    }
+    printf("elapsed: %lu ms\n", (unsigned long)elapsed);
+
+    if (run.files != NULL)
+    {
+        for (i = 0; i < run.games; i++)
+            free(run.files[i]);
+        free(run.files);
+    }
+    closeArchive(run.archive);
+    free(run.results);
+    free(workers);
+    return invalid > 0 || unreadable > 0;
+}
+
+/* Records of one game of a book run */
+typedef struct _BookGame {
+    BookRecord *records;
+    int count;
+} BookGame;
+
+/* A book run shared by its worker threads */
+typedef struct _BookRun {
+    int size;
+    uint64_t seed;
+    int games;
+    int turns;
+    int next;
+    BookGame *results;
+} BookRun;
+
+/* Play the opening turns of games given[next], ... of a book run and
+ * record the chain the search picks in every position.
+ */
+void *bookWorker(void *arg)
+{
+    BookRun *run = (BookRun *)arg;
+    BookGame *result;
+    BookRecord *record;
+    Player *players[2], *tmp;
+    Board *board;
+    Chain chain;
+    int game, turn, i;
+
+    while ((game = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) < run->games)
+    {
+        result = &run->results[game];
+        result->records = (BookRecord *)malloc(run->turns * sizeof(BookRecord));
+        board = initBoardSeeded(run->size, run->seed + (uint64_t)game);
+        players[0] = createPlayer(1, COMPUTER, "Computer1");
+        players[1] = createPlayer(2, COMPUTER, "Computer2");
+        for (turn = 0; turn < run->turns; turn++)
+        {
+            computerChooseChain(board, players[0], players[1], &chain);
+            if (chain.length == 0 || chain.length > TT_CHAIN_HOPS)
+                break;
+            record = &result->records[result->count++];
+            record->size = run->size;
+            record->key = positionKey(board, players[0], players[1]);
+            record->score = chain.score;
+            record->chain.from = chain.from;
+            record->chain.length = chain.length;
+            memset(record->chain.dirs, 0, sizeof(record->chain.dirs));
+            for (i = 0; i < chain.length; i++)
+                record->chain.dirs[i >> 2] |= chain.dirs[i] << ((i & 3) * 2);
+            if (!playChain(board, players[0], &chain, NULL))
+                break;
+            tmp = players[0];
+            players[0] = players[1];
+            players[1] = tmp;
+        }
+        freeBoard(board);
+        freePlayer(players[0]);
+        freePlayer(players[1]);
+    }
+    return NULL;
+}
+
+int compareBookRecords(const void *a, const void *b)
+{
+    const BookRecord *x = (const BookRecord *)a, *y = (const BookRecord *)b;
+    if (x->size != y->size)
+        return x->size < y->size ? -1 : 1;
+    if (x->key != y->key)
+        return x->key < y->key ? -1 : 1;
+    return y->order - x->order;
+}
+
+/* Write a book of records sorted by size and key. The new book is
+ * renamed over the old one, so running games keep their mapping.
+ *
+ * Returns:
+ *     0 on success, 1 if the file cannot be written.
+ */
+int writeBook(char *filename, BookRecord *records, int count)
+{
+    unsigned char header[BOOK_HEADER], *sections, entry[BOOK_ENTRY];
+    char temp[300];
+    FILE *file;
+    uint64_t offset;
+    int sectionCount = 0, i, k, ok;
+
+    for (i = 0; i < count; i++)
+        sectionCount += i == 0 || records[i].size != records[i - 1].size;
+    sections = (unsigned char *)calloc(sectionCount > 0 ? sectionCount : 1, BOOK_SECTION);
+    memset(header, 0, sizeof(header));
+    memcpy(header, BOOK_MAGIC, 4);
+    header[4] = BOOK_VERSION;
+    header[5] = sectionCount;
+    offset = BOOK_HEADER + (uint64_t)sectionCount * BOOK_SECTION;
+    for (i = 0, k = -1; i < count; i++)
+    {
+        if (i == 0 || records[i].size != records[i - 1].size)
+        {
+            k++;
+            sections[k * BOOK_SECTION] = records[i].size;
+            put64(sections + k * BOOK_SECTION + 8, offset + (uint64_t)i * BOOK_ENTRY);
+        }
+        put32(sections + k * BOOK_SECTION + 4, get32(sections + k * BOOK_SECTION + 4) + 1);
+    }
+
+    snprintf(temp, sizeof(temp), "%s.tmp", filename);
+    file = fopen(temp, "wb");
+    if (file == NULL)
+    {
+        free(sections);
+        return 1;
+    }
+    ok = fwrite(header, 1, BOOK_HEADER, file) == BOOK_HEADER &&
+         fwrite(sections, BOOK_SECTION, sectionCount, file) == (size_t)sectionCount;
+    for (i = 0; ok && i < count; i++)
+    {
+        memset(entry, 0, sizeof(entry));
+        put64(entry, records[i].key);
+        put32(entry + 8, (uint32_t)records[i].score);
+        entry[12] = records[i].chain.from;
+        entry[13] = records[i].chain.from >> 8;
+        entry[14] = records[i].chain.length;
+        memcpy(entry + 16, records[i].chain.dirs, sizeof(records[i].chain.dirs));
+        ok = fwrite(entry, 1, BOOK_ENTRY, file) == BOOK_ENTRY;
+    }
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    fclose(file);
+    free(sections);
+    if (!ok || rename(temp, filename) != 0)
+    {
+        remove(temp);
+        return 1;
+    }
+    return 0;
+}
+
+/* Add the opening positions of seeded games to a book, creating it if
+ * needed. Game i starts from board seed + i, and the chain the current
+ * search settings pick is recorded for its first `turns` turns; the
+ * entries of other board sizes and other positions are kept.
+ *
+ * Parameters:
+ *     filename: the book
+ *     size: board size
+ *     seed: seed of the first game
+ *     games: number of games
+ *     turns: turns recorded per game
+ *     threads: games played in parallel
+ */
+int runMakeBook(char *filename, int size, uint64_t seed, int games, int turns, int threads)
+{
+    OpeningBook *book;
+    BookRun run;
+    BookRecord *records;
+    const unsigned char *entries;
+    pthread_t *workers;
+    pthread_attr_t attr;
+    uint64_t start, elapsed;
+    uint32_t sectionCount, e;
+    int count = 0, capacity = 0, old = 0, kept, i, k;
+
+    if (size % 2 != 0 || size < 4 || size > MAX_BOARD_SIZE || games < 1 || turns < 1 || threads < 1 ||
+        threads > MAX_THREADS)
     {
-        y = yaxis - 'A' + 9;
+        printf("Invalid book parameters\n");
+        return 1;
     }
-    else if (yaxis >= 'a' && yaxis <= 'z')
+    book = openBook(filename);
+    if (book == NULL && access(filename, F_OK) == 0)
     {
-        y = yaxis - 'a' + 9;
+        printf("Not an opening book: %s\n", filename);
+        return 1;
     }
 
-    move = createMove(x, y, 0);
+    run.size = size;
+    run.seed = seed;
+    run.games = games;
+    run.turns = turns;
+    run.next = 0;
+    run.results = (BookGame *)calloc(games, sizeof(BookGame));
+    workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    headlessMode = 1;
+    initZobrist();
 
-    if (x < 0 || x >= board->size || y < 0 || y >= board->size)
+    start = monotonicMs();
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK);
+    for (i = 0; i < threads; i++)
+        pthread_create(&workers[i], &attr, bookWorker, &run);
+    for (i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+    pthread_attr_destroy(&attr);
+    elapsed = monotonicMs() - start;
+
+    /* the old entries first, so new ones of the same position win */
+    for (i = 0; book != NULL && i < book->sections; i++)
+        capacity += get32(book->map + BOOK_HEADER + i * BOOK_SECTION + 4);
+    for (i = 0; i < games; i++)
+        capacity += run.results[i].count;
+    records = (BookRecord *)malloc((capacity > 0 ? capacity : 1) * sizeof(BookRecord));
+    for (i = 0; book != NULL && i < book->sections; i++)
     {
-        printError(board, "Invalid move\n");
-        free(move);
-        return humanMakeMove(board, player, Opponent, outfile);
+        k = book->map[BOOK_HEADER + i * BOOK_SECTION];
+        entries = bookSection(book, k, &sectionCount);
+        for (e = 0; e < sectionCount; e++, count++)
+        {
+            bookRecord(entries + (size_t)e * BOOK_ENTRY, k, &records[count]);
+            records[count].order = count;
+        }
     }
-
-    if (board->cells[x][y] == EMPTY)
+    old = count;
+    for (i = 0; i < games; i++)
     {
-        printError(board, "Empty cell\n");
-        free(move);
-        return humanMakeMove(board, player, Opponent, outfile);
+        for (k = 0; k < run.results[i].count; k++, count++)
+        {
+            records[count] = run.results[i].records[k];
+            records[count].order = count;
+        }
+        free(run.results[i].records);
     }
+    closeBook(book);
 
-    if (isNextMoveAvailable(board, move) == 0)
+    qsort(records, count, sizeof(BookRecord), compareBookRecords);
+    for (i = 0, kept = 0; i < count; i++)
     {
-        printError(board, "No move available\n");
-        free(move);
-        return humanMakeMove(board, player, Opponent, outfile);
+        if (kept == 0 || records[i].size != records[kept - 1].size || records[i].key != records[kept - 1].key)
+            records[kept++] = records[i];
     }
 
-    whitePiece(board, move->PieceX, move->PieceY);
-
-    while (nextMoveAvailable)
+    i = writeBook(filename, records, kept);
+    if (i != 0)
+        printf("Cannot write %s\n", filename);
+    else
     {
-        int dirValid = 0;
-        Piece c;
-        whitePiece(board, move->PieceX, move->PieceY);
-        printControl(board, COLOR_BLUE "Direction: " COLOR_RESET);
+        printf("games: %d\n", games);
+        printf("size: %d\n", size);
+        printf("positions searched: %d\n", count - old);
+        printf("book entries: %d (was %d)\n", kept, old);
+        printf("elapsed: %lu ms\n", (unsigned long)elapsed);
+    }
+    free(records);
+    free(run.results);
+    free(workers);
+    return i;
+}
 
-        while (dirValid == 0)
-        {
-            Direction dir = getDirection(board);
-            if (dir == NO_DIRECTION)
-            {
-                return 1;
-            }
-            move->direction = dir;
-            last = *move;
-            c = isMoveValid(board, move);
-            if (c != INVALID_PIECE)
-            {
-                dirValid = 1;
-            }
-            else
-            {
-                printError(board, "Invalid move\n");
-            }
-        }
-        player->pieces[c - 'A']++;
+/* Solving of small boards, see runSolve */
+#define SOLVE_MAX_SIZE 6
+/* bytes of value table shared out among the workers */
+#define SOLVE_MEMORY ((size_t)1 << 28)
+#define SOLVE_MIN_TABLE (1 << 16)
+#define SOLVE_NODE_LIMIT 5000000
 
-        /* calculate the score, */ 
-        score = 1;
-        for (i = 0; i < 5; i++)
-        {
-            if (player->pieces[i] == 0)
-            {
-                score = 0;
-            }
-        }
-        if (score)
-        {
-            player->score++;
-            for (i = 0; i < 5; i++)
-            {
-                player->pieces[i]--;
-            }
-        }
+/* Result of solving one board, once with each player to move first */
+typedef struct _SolveResult {
+    int solved[2];
+    int value[2];
+    unsigned long nodes;
+} SolveResult;
 
-        movePiece(board, move);
-        renderBoard(board);
-        move->playerId = player->id;
-        /* ask if redo */ 
-        if (redoAvailable)
-        {
-            printControl(board, "Do you want to undo? " COLOR_RED "(y/n)" COLOR_RESET ": ");
-            char redo;
-            scanf(" %c", &redo);
-            if (redo == 'y' || redo == 'Y')
-            {
-                redoAvailable = 0;
-                /* undo the move */ 
-                undoMove(board, move, c);
-                renderBoard(board);
-                
-                /* undo the score */
-                if (score)
-                {
-                    player->score--;
-                    for (i = 0; i < 5; i++)
-                    {
-                        player->pieces[i]++;
-                    }
-                }
-                player->pieces[c - 'A']--;
+/* A solve run shared by its worker threads */
+typedef struct _SolveRun {
+    int size;
+    uint64_t seed;
+    int games;
+    unsigned long limit;
+    int next;
+    SolveResult *results;
+    /* the solved positions of every worker */
+    Endgame **solvers;
+} SolveRun;
 
+typedef struct _SolveWorker {
+    SolveRun *run;
+    Endgame *eg;
+} SolveWorker;
 
-                printControl(board, "Redo move? " COLOR_RED "(y/n)" COLOR_RESET ": ");
-                char redo;
-                scanf(" %c", &redo);
-                if (redo == 'y' || redo =='Y')
-                {
-                    /* redo the mov, do the first move again */
-                    movePiece(board, &last);
-                }
-                else
-                {
-                    dirValid = 0;
-                    whitePiece(board, move->PieceX, move->PieceY);
-                    while (dirValid == 0)
-                    {
-                        Direction dir = getDirection(board);
-                        if (dir == NO_DIRECTION)
-                        {
-                            return 1;
-                        }
-                        move->direction = dir;
-                        c = isMoveValid(board, move);
-                        if (c != INVALID_PIECE)
-                        {
-                            dirValid = 1;
-                        }
-                        else
-                        {
-                            printError(board, "Invalid move\n");
-                        }
-                    }
+/* Solve boards given[next], ... of a solve run until none are left */
+void *solveWorker(void *arg)
+{
+    SolveWorker *worker = (SolveWorker *)arg;
+    SolveRun *run = worker->run;
+    Endgame *eg = worker->eg;
+    SolveResult *result;
+    Player *players[2];
+    Board *board;
+    int game, first;
 
-                    player->pieces[c - 'A']++;
-                    movePiece(board, move);
-                    renderBoard(board);
-                    move->playerId = player->id;
-                }
-            }
+    while ((game = __atomic_fetch_add(&run->next, 1, __ATOMIC_RELAXED)) < run->games)
+    {
+        result = &run->results[game];
+        board = initBoardSeeded(run->size, run->seed + (uint64_t)game);
+        players[0] = createPlayer(1, COMPUTER, "Computer1");
+        players[1] = createPlayer(2, COMPUTER, "Computer2");
+        for (first = 0; first < 2; first++)
+        {
+            eg->nodes = 0;
+            eg->aborted = 0;
+            result->value[first] = endgameSolve(eg, board, players[first], players[1 - first], 0, -EVAL_INF, EVAL_INF);
+            result->solved[first] = !eg->aborted;
+            result->nodes += eg->nodes;
         }
-        saveMove(outfile, *move);
-        move->PieceX += (move->direction == UP ? -2 : move->direction == DOWN ? 2 : 0);
-        move->PieceY += (move->direction == LEFT ? -2 : move->direction == RIGHT ? +2 : 0);
-        nextMoveAvailable = isNextMoveAvailable(board, move);
+        freeBoard(board);
+        freePlayer(players[0]);
+        freePlayer(players[1]);
     }
+    return NULL;
+}
 
-    free(move);
-    return 1;
+int compareSolvedRecords(const void *a, const void *b)
+{
+    const SolvedRecord *x = (const SolvedRecord *)a, *y = (const SolvedRecord *)b;
+    return x->key < y->key ? -1 : x->key > y->key ? 1 : 0;
 }
 
-/* Calculate the best score for a given position and direction.
- *
- * Parameters:
- *     N: the size of the matrix (assuming it's a square matrix).
- *     matrix: a pointer to a 2D array representing the game matrix.
- *     posY: the y-coordinate of the current position.
- *     posX: the x-coordinate of the current position.
- *     direction: a pointer to a Direction variable to set the best direction.
+/* Write a database of records with distinct keys, all positions of
+ * boards of the given size. The new file is renamed over the old one,
+ * so running games keep their mapping.
  *
  * Returns:
- *     The best score calculated for the given position and direction.
+ *     0 on success, 1 if the file cannot be written.
  */
-int calculateBestScore(int N, int **matrix, int posY, int posX, Direction *direction)
+int writeSolvedDb(char *filename, int size, SolvedRecord *records, size_t count)
 {
-    int tmpScore;
-    int score = 0;
-    Direction tmp_direction = 0;
-    int maxScore = 0;
+    unsigned char *data, *slot;
+    char temp[300];
+    uint64_t slots = 16, at;
+    uint32_t probe = 0, n;
+    size_t length, i;
+    FILE *file;
+    int ok;
 
-    /* check if can move up */
-    if (
-        posX - 2 >= 0 &&
-        matrix[posX - 2][posY] == 0 &&
-        matrix[posX - 1][posY] != 0
-    )
+    /* at most half full keeps the probes short */
+    while (slots < 2 * (uint64_t)count)
+        slots *= 2;
+    length = SOLVED_HEADER + slots * SOLVED_ENTRY;
+    data = (unsigned char *)calloc(length, 1);
+    for (i = 0; i < count; i++)
     {
-        /* simulate move */
-        tmpScore = matrix[posX - 1][posY];
-        matrix[posX - 2][posY] = matrix[posX][posY];
-        matrix[posX][posY] = 0;
-        matrix[posX - 1][posY] = 0;
-        tmp_direction = UP;
-        score = tmpScore + calculateBestScore(N, matrix, posY, posX - 2, &tmp_direction);
-        if (score > maxScore)
+        for (n = 0, at = records[i].key & (slots - 1);; n++, at = (at + 1) & (slots - 1))
         {
-            maxScore = score;
-            *direction = UP;
+            slot = data + SOLVED_HEADER + at * SOLVED_ENTRY;
+            if (get64(slot) == 0)
+                break;
         }
-        /* undo move */
-        matrix[posX][posY] = matrix[posX - 2][posY];
-        matrix[posX - 2][posY] = 0;
-        matrix[posX - 1][posY] = tmpScore;
+        if (n > probe)
+            probe = n;
+        put64(slot, records[i].key);
+        put32(slot + 8, (uint32_t)records[i].value);
+        slot[12] = records[i].from;
+        slot[13] = records[i].from >> 8;
+        slot[14] = records[i].length;
+        memcpy(slot + 16, records[i].dirs, sizeof(records[i].dirs));
     }
+    memcpy(data, SOLVED_MAGIC, 4);
+    data[4] = SOLVED_VERSION;
+    data[5] = size;
+    put64(data + 8, slots);
+    put64(data + 16, count);
+    put32(data + 24, probe);
 
-    /* check if can move down */
-    if (
-        posX + 2 < N &&
-        matrix[posX + 2][posY] == 0 &&
-        matrix[posX + 1][posY] != 0
-    )
+    snprintf(temp, sizeof(temp), "%s.tmp", filename);
+    file = fopen(temp, "wb");
+    if (file == NULL)
     {
-        /* simulate move */
-        tmpScore = matrix[posX + 1][posY];
-        matrix[posX + 2][posY] = matrix[posX][posY];
-        matrix[posX][posY] = 0;
-        matrix[posX + 1][posY] = 0;
-        tmp_direction = DOWN;
-        score = tmpScore + calculateBestScore(N, matrix, posY, posX + 2, &tmp_direction);
-        if (score > maxScore)
-        {
-            maxScore = score;
-            *direction = DOWN;
-        }
-        /* undo move */
-        matrix[posX][posY] = matrix[posX + 2][posY];
-        matrix[posX + 2][posY] = 0;
-        matrix[posX + 1][posY] = tmpScore;
+        free(data);
+        return 1;
+    }
+    ok = fwrite(data, 1, length, file) == length;
+    ok = fflush(file) == 0 && fsync(fileno(file)) == 0 && ok;
+    fclose(file);
+    free(data);
+    if (!ok || rename(temp, filename) != 0)
+    {
+        remove(temp);
+        return 1;
     }
+    return 0;
+}
 
-    /* check if can move left */
-    if (
-        posY - 2 >= 0 &&
-        matrix[posX][posY - 2] == 0 &&
-        matrix[posX][posY - 1] != 0
-    )
+/* Solve seeded small boards exactly and add every position the solver
+ * proved to a solved position database, creating it if needed. Board i
+ * is made from seed + i and solved with either player moving first;
+ * each worker keeps its own value table across its boards, together
+ * SOLVE_MEMORY bytes. A board whose
+ * solve needs more than `limit` nodes is reported as unsolved, the
+ * positions proved on the way are still added.
+ *
+ * Parameters:
+ *     filename: the database
+ *     size: board size, at most SOLVE_MAX_SIZE
+ *     seed: seed of the first board
+ *     games: number of boards
+ *     threads: boards solved in parallel
+ *     limit: nodes per solve
+ */
+int runSolve(char *filename, int size, uint64_t seed, int games, int threads, unsigned long limit)
+{
+    SolvedDb *db;
+    SolveRun run;
+    SolveWorker *workers;
+    SolvedRecord *records;
+    pthread_t *threadIds;
+    pthread_attr_t attr;
+    uint64_t start, elapsed, at;
+    unsigned long nodes = 0;
+    size_t count = 0, capacity = 0, kept, i, entries;
+    int solved = 0, wins[2] = { 0, 0 }, draws = 0, k;
+
+    if (size % 2 != 0 || size < 4 || size > SOLVE_MAX_SIZE || games < 1 || threads < 1 || threads > MAX_THREADS ||
+        limit < 1)
     {
-        /* simulate move */
-        tmpScore = matrix[posX][posY - 1];
-        matrix[posX][posY - 2] = matrix[posX][posY];
-        matrix[posX][posY] = 0;
-        matrix[posX][posY - 1] = 0;
-        tmp_direction = LEFT;
-        score = tmpScore + calculateBestScore(N, matrix, posY - 2, posX, &tmp_direction);
-        if (score > maxScore)
+        printf("Invalid solve parameters\n");
+        return 1;
+    }
+    db = openSolvedDb(filename);
+    if (db == NULL && access(filename, F_OK) == 0)
+    {
+        printf("Not a solved position database: %s\n", filename);
+        return 1;
+    }
+    if (db != NULL && db->size != size)
+    {
+        printf("%s holds %dx%d positions\n", filename, db->size, db->size);
+        closeSolvedDb(db);
+        return 1;
+    }
+
+    run.size = size;
+    run.seed = seed;
+    run.games = games;
+    run.limit = limit;
+    run.next = 0;
+    run.results = (SolveResult *)calloc(games, sizeof(SolveResult));
+    workers = (SolveWorker *)calloc(threads, sizeof(SolveWorker));
+    threadIds = (pthread_t *)malloc(threads * sizeof(pthread_t));
+    headlessMode = 1;
+    initZobrist();
+
+    /* the largest power of two that fits each worker's share */
+    for (entries = SOLVE_MIN_TABLE; 2 * entries * sizeof(EndgameEntry) * threads <= SOLVE_MEMORY;)
+        entries *= 2;
+
+    start = monotonicMs();
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SEARCH_THREAD_STACK);
+    for (k = 0; k < threads; k++)
+    {
+        workers[k].run = &run;
+        workers[k].eg = createEndgame(entries, size * size, limit);
+        workers[k].eg->capacity = 1024;
+        workers[k].eg->records = (SolvedRecord *)malloc(workers[k].eg->capacity * sizeof(SolvedRecord));
+        pthread_create(&threadIds[k], &attr, solveWorker, &workers[k]);
+    }
+    for (k = 0; k < threads; k++)
+        pthread_join(threadIds[k], NULL);
+    pthread_attr_destroy(&attr);
+    elapsed = monotonicMs() - start;
+
+    /* the old entries first, new ones of the same position replace them */
+    capacity = db != NULL ? db->count : 0;
+    for (k = 0; k < threads; k++)
+        capacity += workers[k].eg->count;
+    records = (SolvedRecord *)malloc((capacity > 0 ? capacity : 1) * sizeof(SolvedRecord));
+    for (at = 0; db != NULL && at < db->slots; at++)
+    {
+        if (get64(db->map + SOLVED_HEADER + at * SOLVED_ENTRY) != 0)
+            solvedRecord(db->map + SOLVED_HEADER + at * SOLVED_ENTRY, &records[count++]);
+    }
+    closeSolvedDb(db);
+    for (k = 0; k < threads; k++)
+    {
+        memcpy(records + count, workers[k].eg->records, workers[k].eg->count * sizeof(SolvedRecord));
+        count += workers[k].eg->count;
+        freeEndgame(workers[k].eg);
+    }
+
+    /* values are exact, so any record of a key will do */
+    qsort(records, count, sizeof(SolvedRecord), compareSolvedRecords);
+    for (i = 0, kept = 0; i < count; i++)
+    {
+        if (kept == 0 || records[i].key != records[kept - 1].key)
+            records[kept++] = records[i];
+    }
+
+    k = writeSolvedDb(filename, size, records, kept);
+    if (k != 0)
+        printf("Cannot write %s\n", filename);
+    else
+    {
+        for (i = 0; i < (size_t)games; i++)
         {
-            maxScore = score;
-            *direction = LEFT;
+            nodes += run.results[i].nodes;
+            if (!run.results[i].solved[0] || !run.results[i].solved[1])
+                continue;
+            solved++;
+            /* player 1 moving first, in sets */
+            if (run.results[i].value[0] >= EVAL_SET / 2)
+                wins[0]++;
+            else if (run.results[i].value[0] <= -EVAL_SET / 2)
+                wins[1]++;
+            else
+                draws++;
         }
-        /* undo move */
-        matrix[posX][posY] = matrix[posX][posY - 2];
-        matrix[posX][posY - 2] = 0;
-        matrix[posX][posY - 1] = tmpScore;
+        printf("boards: %d\n", games);
+        printf("size: %d\n", size);
+        printf("threads: %d\n", threads);
+        printf("solved: %d\n", solved);
+        printf("player1 first, player1 wins: %d\n", wins[0]);
+        printf("player1 first, player2 wins: %d\n", wins[1]);
+        printf("player1 first, draws: %d\n", draws);
+        printf("nodes: %lu\n", nodes);
+        printf("positions: %lu\n", (unsigned long)kept);
+        printf("elapsed: %lu ms\n", (unsigned long)elapsed);
     }
-    return maxScore;
+    free(records);
+    free(run.results);
+    free(workers);
+    free(threadIds);
+    return k;
 }
 
-int computerMakeMove(Board *board, Player *player, Player *opponent, char *outfile)
+/* Place a key in a table that has room for it */
+int keySetPlace(uint64_t *keys, size_t mask, uint64_t key, size_t *count)
 {
-    /*
-     * Create a matrix for the board: 
-     * 1. If the cell is empty, assign 0 otherwise assign 1
-     * 2. If the cell is a piece which player needs, multiply it by 2
-     * 3. If the cell is a piece which opponent needs, multiply it by 2
-    */
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ULL) & mask;
+    while (keys[i] != 0)
+    {
+        if (keys[i] == key)
+            return 0;
+        i = (i + 1) & mask;
+    }
+    keys[i] = key;
+    (*count)++;
+    return 1;
+}
 
-    int i, j, k;
-    int maxScore = 0;
-    int score;
+/* Insert a key into a set, growing it when half full.
+ *
+ * Returns:
+ *     1 if the key was new, 0 if it was already there.
+ */
+int keySetInsert(KeySet *set, uint64_t key)
+{
+    size_t i, size;
+    uint64_t *old;
 
-    int **matrix = (int **)malloc(board->size * sizeof(int *));
-    for (i = 0; i < board->size; i++)
+    if (key == 0)
+        key = 1;
+    if (set->keys == NULL || (set->count + 1) * 2 > set->mask + 1)
     {
-        matrix[i] = (int *)malloc(board->size * sizeof(int));
-        for (j = 0; j < board->size; j++)
+        old = set->keys;
+        size = set->keys == NULL ? 1024 : (set->mask + 1) * 2;
+        set->keys = (uint64_t *)calloc(size, sizeof(uint64_t));
+        set->count = 0;
+        if (old != NULL)
         {
-            matrix[i][j] = 0;
-            if (board->cells[i][j] == EMPTY)
-                matrix[i][j] = 0;
-            else
-                matrix[i][j] = 1;
-            
-            /* check if opponent wants it */
-            for (k = 0; k < 5; k++)
-            {
-                if (opponent->pieces[k] != 0)
-                {
-                    if (board->cells[i][j] == 'A' + k)
-                    {
-                        matrix[i][j] *= 2;
-                    }
-                }
-            }
-
-            /* check if player wants it */
-            for (k = 0; k < 5; k++)
+            for (i = 0; i <= set->mask; i++)
             {
-                if (player->pieces[k] == 0)
-                {
-                    if (board->cells[i][j] == 'A' + k)
-                    {
-                        matrix[i][j] *= 2;
-                    }
-                }
+                if (old[i] != 0)
+                    keySetPlace(set->keys, size - 1, old[i], &set->count);
             }
+            free(old);
         }
+        set->mask = size - 1;
     }
+    return keySetPlace(set->keys, set->mask, key, &set->count);
+}
 
-    /* Find the best move */
-    int bestX = 0;
-    int bestY = 0;
-    Direction bestDirection = UP;
-    Direction direction;
+/* Count chains and positions below a node with the jump generator */
+unsigned long perftFast(Perft *perft, Board *board, Player *me, Player *opp, int ply)
+{
+    ChainList *list = &perft->lists[ply];
+    Piece taken[MAX_CHAIN];
+    int saved[6];
+    unsigned long leaves = 0;
+    int i;
+
+    keySetInsert(&perft->positions[ply], positionKey(board, me, opp));
+    if (ply == perft->depth)
+    {
+        perft->nodes[ply]++;
+        return 1;
+    }
+
+    generateChains(board, list, 0);
+    if (list->truncated)
+        perft->truncated = 1;
+    perft->chains[ply] += list->count;
+    if (list->count == 0)
+    {
+        perft->terminal[ply]++;
+        return 0;
+    }
+    perft->nodes[ply]++;
+
+    for (i = 0; i < list->count; i++)
+    {
+        makeChain(board, me, list, i, taken, saved);
+        leaves += perftFast(perft, board, opp, me, ply + 1);
+        unmakeChain(board, me, list, i, taken, saved);
+    }
+    return leaves;
+}
+
+unsigned long perftReference(Perft *perft, Board *board, Player *me, Player *opp, int ply);
+
+/* Chains from (x, y) with isMoveValid and movePiece, the reference the
+ * jump generator is checked against. Every prefix of a chain is a turn.
+ */
+unsigned long perftReferenceChains(Perft *perft, Board *board, Player *me, Player *opp, int ply, int x, int y)
+{
+    unsigned long leaves = 0;
+    Move move;
+    Piece c;
+    int d, k, savedPieces[5], savedScore;
+
+    move.PieceX = x;
+    move.PieceY = y;
+    move.next = NULL;
+    move.playerId = me->id;
+    for (d = UP; d <= RIGHT; d++)
+    {
+        move.direction = d;
+        c = isMoveValid(board, &move);
+        if (c == INVALID_PIECE)
+            continue;
+        for (k = 0; k < 5; k++)
+            savedPieces[k] = me->pieces[k];
+        savedScore = me->score;
+        takePiece(me, c);
+        movePiece(board, &move);
+
+        perft->chains[ply]++;
+        leaves += perftReference(perft, board, opp, me, ply + 1);
+        leaves += perftReferenceChains(perft, board, me, opp, ply, x + 2 * directionDX[d], y + 2 * directionDY[d]);
+
+        undoMove(board, &move, c);
+        for (k = 0; k < 5; k++)
+            me->pieces[k] = savedPieces[k];
+        me->score = savedScore;
+    }
+    return leaves;
+}
+
+unsigned long perftReference(Perft *perft, Board *board, Player *me, Player *opp, int ply)
+{
+    unsigned long leaves = 0, before;
+    int i, j;
+
+    if (ply == perft->depth)
+    {
+        perft->nodes[ply]++;
+        return 1;
+    }
+
+    before = perft->chains[ply];
     for (i = 0; i < board->size; i++)
     {
         for (j = 0; j < board->size; j++)
         {
-            Move dummy;
-            dummy.PieceX = i;
-            dummy.PieceY = j;
-            dummy.direction = 0;
-            /* if can move piece, calculate the max score */
-            if (matrix[i][j] != 0 && isNextMoveAvailable(board, &dummy))
-            {
-                score = calculateBestScore(board->size, matrix, j, i, &direction);
-                if (score > maxScore)
-                {
-                    maxScore = score;
-                    bestX = i;
-                    bestY = j;
-                    bestDirection = direction;
-                }
-            }
+            if (board->cells[i][j] != EMPTY)
+                leaves += perftReferenceChains(perft, board, me, opp, ply, i, j);
         }
     }
+    if (perft->chains[ply] == before)
+        perft->terminal[ply]++;
+    else
+        perft->nodes[ply]++;
+    return leaves;
+}
 
-    /* make the move */
-    Move *move = createMove(bestX, bestY, bestDirection);
-    if (maxScore == 0)
+/* Print the chain in list as "x,y:DIRS" with 1-based coordinates */
+void printChainRef(Board *board, ChainList *list, int i)
+{
+    ChainRef *ref = &list->chains[i];
+    int k;
+    printf("%d,%d:", ref->from / board->size + 1, ref->from % board->size + 1);
+    for (k = 0; k < ref->length; k++)
     {
-        printError(board, "Computer cannot make a move\nGame Over!\n");
-        return 0;
+        putchar("WSAD"[list->pool[ref->offset + k]]);
     }
-    Piece c = isMoveValid(board, move);
-    move->playerId = player->id;
-    if (c == INVALID_PIECE)
+}
+
+/* Count every chain and every position up to depth turns from a board.
+ * A turn is any non-empty chain, since a player may stop at any hop.
+ * divide prints the leaf count below each root chain; reference repeats
+ * the count with isMoveValid/movePiece and compares the results.
+ */
+int runPerft(Board *board, int depth, int divide, int reference)
+{
+    Perft perft, check;
+    Player *me = createPlayer(1, COMPUTER, "Perft1");
+    Player *opp = createPlayer(2, COMPUTER, "Perft2");
+    Piece taken[MAX_CHAIN];
+    int saved[6];
+    unsigned long leaves = 0, total = 0, below;
+    uint64_t start, elapsed;
+    int i, mismatch = 0;
+
+    if (depth < 1 || depth > PERFT_MAX_DEPTH)
     {
-        /* bot give up */
-        printError(board, "Computer cannot make a move\nGame Over!\n");
-        return 0;
+        printf("Depth must be between 1 and %d\n", PERFT_MAX_DEPTH);
+        return 1;
     }
 
-    player->pieces[c - 'A']++;
-    
-    /* calculate the score, */ 
-    int sscore = 1;
-    for (i = 0; i < 5; i++)
+    memset(&perft, 0, sizeof(Perft));
+    perft.depth = depth;
+    perft.lists = (ChainList *)malloc((depth + 1) * sizeof(ChainList));
+
+    start = monotonicMs();
+    if (divide)
     {
-        if (player->pieces[i] == 0)
+        keySetInsert(&perft.positions[0], positionKey(board, me, opp));
+        generateChains(board, &perft.lists[0], 0);
+        perft.chains[0] = perft.lists[0].count;
+        if (perft.lists[0].count == 0)
+            perft.terminal[0]++;
+        else
+            perft.nodes[0]++;
+        for (i = 0; i < perft.lists[0].count; i++)
         {
-            sscore = 0;
+            makeChain(board, me, &perft.lists[0], i, taken, saved);
+            below = perftFast(&perft, board, opp, me, 1);
+            unmakeChain(board, me, &perft.lists[0], i, taken, saved);
+            leaves += below;
+            printChainRef(board, &perft.lists[0], i);
+            printf(" %lu\n", below);
         }
     }
-    if (sscore)
+    else
     {
-        player->score++;
-        for (i = 0; i < 5; i++)
+        leaves = perftFast(&perft, board, me, opp, 0);
+    }
+    elapsed = monotonicMs() - start;
+
+    for (i = 0; i <= depth; i++)
+    {
+        total += perft.nodes[i] + perft.terminal[i];
+        printf("depth %d: nodes %lu, chains %lu, positions %lu, game over %lu\n", i,
+               perft.nodes[i], i < depth ? perft.chains[i] : 0UL,
+               (unsigned long)perft.positions[i].count, perft.terminal[i]);
+        free(perft.positions[i].keys);
+    }
+    printf("leaves: %lu\n", leaves);
+    printf("elapsed: %lu ms\n", (unsigned long)elapsed);
+    printf("nodes per second: %.0f\n", elapsed ? total * 1000.0 / elapsed : 0.0);
+    if (perft.truncated)
+        printf("warning: chain list full, counts are incomplete\n");
+
+    if (reference)
+    {
+        memset(&check, 0, sizeof(Perft));
+        check.depth = depth;
+        start = monotonicMs();
+        perftReference(&check, board, me, opp, 0);
+        elapsed = monotonicMs() - start;
+        for (i = 0; i <= depth; i++)
         {
-            player->pieces[i]--;
+            if (check.nodes[i] != perft.nodes[i] || check.terminal[i] != perft.terminal[i] ||
+                (i < depth && check.chains[i] != perft.chains[i]))
+            {
+                printf("reference mismatch at depth %d: nodes %lu, chains %lu, game over %lu\n", i,
+                       check.nodes[i], check.chains[i], check.terminal[i]);
+                mismatch = 1;
+            }
         }
+        printf("reference: %s, %lu ms\n", mismatch ? "MISMATCH" : "ok", (unsigned long)elapsed);
     }
 
-    movePiece(board, move);
-    saveMove(outfile, *move);
+    free(perft.lists);
+    freePlayer(me);
+    freePlayer(opp);
+    return mismatch;
+}
+
+/* Nanoseconds from a monotonic clock */
+uint64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int compareU64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Print one CSV row of a benchmark: mean and percentiles in ns */
+void benchReport(const char *name, int size, uint64_t *samples, int count)
+{
+    uint64_t sum = 0;
+    int i;
+    qsort(samples, count, sizeof(uint64_t), compareU64);
+    for (i = 0; i < count; i++)
+        sum += samples[i];
+    printf("%s,%d,%d,%.1f,%lu,%lu,%lu,%lu\n", name, size, count, (double)sum / count,
+           (unsigned long)samples[count / 2], (unsigned long)samples[count * 9 / 10],
+           (unsigned long)samples[count * 99 / 100], (unsigned long)samples[count - 1]);
+    fflush(stdout);
+}
 
-    /* free */
+/* Weight matrix of the old computer player, for calculateBestScore */
+int **benchMatrix(Board *board)
+{
+    int **matrix = (int **)malloc(board->size * sizeof(int *));
+    int i, j;
     for (i = 0; i < board->size; i++)
     {
-        free(matrix[i]);
+        matrix[i] = (int *)malloc(board->size * sizeof(int));
+        for (j = 0; j < board->size; j++)
+            matrix[i][j] = board->cells[i][j] == EMPTY ? 0 : 1;
     }
-    free(matrix);
-    free(move);
-    return 1;
+    return matrix;
 }
 
-/* Make a move for the player
+/* Time the game primitives on seeded boards of every size from 4 to 20
+ * and print one CSV row per primitive and size. Render output goes to
+ * /dev/null and the save file benchmarks use a temporary file. The
+ * renderBoardBytes row counts bytes per frame instead of nanoseconds.
  *
  * Parameters:
- * - board: the game board
- * - player: the player who will make the move
- * Returns:
- * - the move made by the player
-*/
-int playerMakeMove(Board *board, Player *player, Player *opponent, char *outfile)
-{
-    if (player->type == HUMAN)
-        return humanMakeMove(board, player, opponent, outfile);
-    else
-        return computerMakeMove(board, player, opponent, outfile);
-}
-
-void GameLoop(Board *board, Player *player1, Player *player2, char *outfile, int idx)
+ *     samples: number of timed calls per primitive and size
+ *     seed: seed of the boards
+ */
+int runBenchmarks(int samples, uint64_t seed)
 {
-    int isGameRunning = 1;
-    Player* currentPlayer;
-    Player* nextPlayer;
-    Player* tmp;
+    uint64_t *times = (uint64_t *)malloc(samples * sizeof(uint64_t));
+    uint64_t *bytes = (uint64_t *)malloc(samples * sizeof(uint64_t));
+    char path[] = "/tmp/skippity-bench-XXXXXX";
+    int size, i, k, fd, stdoutFd, devNull, lastId;
+    uint64_t rng, t;
+    Board *board, *work, *game;
+    Player *p1, *p2;
+    JumpList jumps;
+    Move move;
+    Piece c;
+    Direction dir;
+    int **matrix;
+    GameLoader loader;
 
-    if (idx == 1)
+    if (samples < 1)
     {
-        currentPlayer = player1;
-        nextPlayer = player2;
+        printf("Invalid number of samples\n");
+        return 1;
     }
-    else
+    fd = mkstemp(path);
+    if (fd < 0)
     {
-        currentPlayer = player2;
-        nextPlayer = player1;
+        printf("Cannot create a temporary file\n");
+        return 1;
     }
+    close(fd);
+    devNull = open("/dev/null", O_WRONLY);
+    headlessMode = 1;
 
-    render(board, player1, player2);
-    while (isGameRunning)
+    printf("primitive,size,samples,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n");
+    for (size = 4; size <= MAX_BOARD_SIZE; size += 2)
     {
-        if (playerMakeMove(board, currentPlayer, nextPlayer, outfile) == 0)
+        rng = seed + size;
+        board = initBoardSeeded(size, seed + size);
+        work = copyBoard(board);
+        move.next = NULL;
+        move.playerId = 1;
+
+        for (i = 0; i < samples; i++)
         {
-            isGameRunning = 0;
+            move.PieceX = splitmix64(&rng) % size;
+            move.PieceY = splitmix64(&rng) % size;
+            move.direction = splitmix64(&rng) % 4;
+            t = monotonicNs();
+            c = isMoveValid(board, &move);
+            times[i] = monotonicNs() - t;
         }
-        tmp = currentPlayer;
-        currentPlayer = nextPlayer;
-        nextPlayer = tmp;
+        benchReport("isMoveValid", size, times, samples);
 
-        render(board, player1, player2);
+        for (i = 0; i < samples; i++)
+        {
+            move.PieceX = splitmix64(&rng) % size;
+            move.PieceY = splitmix64(&rng) % size;
+            t = monotonicNs();
+            isNextMoveAvailable(board, &move);
+            times[i] = monotonicNs() - t;
+        }
+        benchReport("isNextMoveAvailable", size, times, samples);
+
+        /* the 4x4 start has no jump, so there is nothing to move */
+        generateJumps(board, &jumps);
+        for (i = 0; i < samples && jumps.count > 0; i++)
+        {
+            k = jumps.jumps[i % jumps.count].from;
+            move.PieceX = k / size;
+            move.PieceY = k % size;
+            move.direction = jumps.jumps[i % jumps.count].direction;
+            c = isMoveValid(work, &move);
+            t = monotonicNs();
+            movePiece(work, &move);
+            undoMove(work, &move, c);
+            times[i] = monotonicNs() - t;
+        }
+        if (jumps.count > 0)
+            benchReport("movePiece+undoMove", size, times, samples);
+
+        matrix = benchMatrix(board);
+        for (i = 0; i < samples && jumps.count > 0; i++)
+        {
+            k = jumps.jumps[i % jumps.count].from;
+            t = monotonicNs();
+            calculateBestScore(size, matrix, k % size, k / size, &dir);
+            times[i] = monotonicNs() - t;
+        }
+        if (jumps.count > 0)
+            benchReport("calculateBestScore", size, times, samples);
+        for (i = 0; i < size; i++)
+            free(matrix[i]);
+        free(matrix);
+
+        /* a fresh position every call so the table never answers */
+        p1 = createPlayer(1, COMPUTER, "Bench1");
+        p2 = createPlayer(2, COMPUTER, "Bench2");
+        p1->search = createSearchContext(size);
+        for (i = 0; i < samples; i++)
+        {
+            game = initBoardSeeded(size, rng++);
+            p1->score = 0;
+            for (k = 0; k < 5; k++)
+                p1->pieces[k] = 0;
+            t = monotonicNs();
+            computerMakeMove(game, p1, p2, NULL);
+            times[i] = monotonicNs() - t;
+            freeBoard(game);
+        }
+        benchReport("computerMakeMove", size, times, samples);
+
+        fflush(stdout);
+        stdoutFd = dup(1);
+        dup2(devNull, 1);
+        for (i = 0; i < samples; i++)
+        {
+            /* a full frame every time, not a diff against the last one */
+            screen.valid = 0;
+            t = monotonicNs();
+            renderBoard(board);
+            times[i] = monotonicNs() - t;
+            bytes[i] = frame.lastBytes;
+        }
+        dup2(stdoutFd, 1);
+        close(stdoutFd);
+        benchReport("renderBoard", size, times, samples);
+        benchReport("renderBoardBytes", size, bytes, samples);
+
+        /* the save file of a full game, used again by loadMoves below */
+        saveBoard(board, path);
+        savePlayer(path, p1);
+        savePlayer(path, p2);
+        copyBoardInto(work, board);
+        p1->score = p2->score = 0;
+        for (k = 0; k < 5; k++)
+            p1->pieces[k] = p2->pieces[k] = 0;
+        for (i = 0; computerMakeMove(work, i % 2 ? p2 : p1, i % 2 ? p1 : p2, path); i++)
+            ;
+        journalClose();
+        copyBoardInto(work, board);
+
+        for (i = 0; i < samples; i++)
+        {
+            copyBoardInto(work, board);
+            p1->score = p2->score = 0;
+            for (k = 0; k < 5; k++)
+                p1->pieces[k] = p2->pieces[k] = 0;
+            t = monotonicNs();
+            loadMoves(path, work, p1, p2, &lastId);
+            times[i] = monotonicNs() - t;
+        }
+        benchReport("loadMoves", size, times, samples);
+
+        for (i = 0; i < samples; i++)
+        {
+            t = monotonicNs();
+            loadGame(path, &loader, NULL);
+            times[i] = monotonicNs() - t;
+            freeLoader(&loader);
+        }
+        benchReport("loadGame", size, times, samples);
+
+        move.PieceX = 0;
+        move.PieceY = 0;
+        move.direction = DOWN;
+        for (i = 0; i < samples; i++)
+        {
+            t = monotonicNs();
+            saveMove(path, move);
+            times[i] = monotonicNs() - t;
+        }
+        benchReport("saveMove", size, times, samples);
+
+        freePlayer(p1);
+        freePlayer(p2);
+        freeBoard(work);
+        freeBoard(board);
     }
+
+    journalClose();
+    close(devNull);
+    remove(path);
+    free(times);
+    free(bytes);
+    return 0;
 }
 
-int main()
+int main(int argc, char **argv)
 {
     int N;
     int gameMode;
     int i;
+    int k;
     char outfile[50];
     Board *board = NULL;
     Player *player1, *player2;
 
+    journalInit();
+    if (argc >= 2 && strcmp(argv[1], "--selfplay") == 0)
+    {
+        if (argc < 6 || parseOptions(argc - 5, argv + 5))
+        {
+            printf("usage: %s --selfplay SIZE SEED GAMES THREADS [options]\n", argv[0]);
+            return 1;
+        }
+        return runSelfPlay(atoi(argv[2]), (uint64_t)strtoul(argv[3], NULL, 10), atoi(argv[4]), atoi(argv[5]));
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--bench") == 0)
+    {
+        if (argc > 4 && parseOptions(argc - 3, argv + 3))
+            return 1;
+        return runBenchmarks(argc > 2 ? atoi(argv[2]) : 1000, argc > 3 ? (uint64_t)strtoul(argv[3], NULL, 10) : 1);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--convert") == 0)
+    {
+        if (argc != 4)
+        {
+            printf("usage: %s --convert INPUT OUTPUT\n", argv[0]);
+            return 1;
+        }
+        return convertSave(argv[2], argv[3]);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--archive") == 0)
+    {
+        if (runArchive(argc - 2, argv + 2) == 0)
+            return 0;
+        if (argc < 4)
+            printf("usage: %s --archive (add ARCHIVE FILE... | list ARCHIVE | get ARCHIVE ID | turn ARCHIVE ID TURN)\n", argv[0]);
+        return 1;
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--make-book") == 0)
+    {
+        if (argc < 8 || parseOptions(argc - 7, argv + 7))
+        {
+            printf("usage: %s --make-book BOOK SIZE SEED GAMES TURNS THREADS [options]\n", argv[0]);
+            return 1;
+        }
+        return runMakeBook(argv[2], atoi(argv[3]), (uint64_t)strtoul(argv[4], NULL, 10), atoi(argv[5]),
+                           atoi(argv[6]), atoi(argv[7]));
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--solve") == 0)
+    {
+        if (argc < 7 || argc > 8)
+        {
+            printf("usage: %s --solve DATABASE SIZE SEED BOARDS THREADS [NODES]\n", argv[0]);
+            return 1;
+        }
+        return runSolve(argv[2], atoi(argv[3]), (uint64_t)strtoul(argv[4], NULL, 10), atoi(argv[5]), atoi(argv[6]),
+                        argc > 7 ? strtoul(argv[7], NULL, 10) : SOLVE_NODE_LIMIT);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--analyze") == 0)
+    {
+        if (argc < 3 || argc > 4)
+        {
+            printf("usage: %s --analyze (DIRECTORY | ARCHIVE | FILE) [THREADS]\n", argv[0]);
+            return 1;
+        }
+        return runAnalysis(argv[2], argc > 3 ? atoi(argv[3]) : 1);
+    }
+
+    if (argc >= 2 && strcmp(argv[1], "--perft") == 0)
+    {
+        int divide = 0, reference = 0, depth, k, args = 0;
+        char *source[2];
+        for (k = 2; k < argc; k++)
+        {
+            if (strcmp(argv[k], "--divide") == 0)
+                divide = 1;
+            else if (strcmp(argv[k], "--reference") == 0)
+                reference = 1;
+            else if (args < 3)
+            {
+                if (args == 0)
+                    depth = atoi(argv[k]);
+                else
+                    source[args - 1] = argv[k];
+                args++;
+            }
+        }
+        if (args < 2)
+        {
+            printf("usage: %s --perft DEPTH (FILE | SIZE SEED) [--divide] [--reference]\n", argv[0]);
+            return 1;
+        }
+        if (args == 3)
+        {
+            N = atoi(source[0]);
+            if (N % 2 != 0 || N < 4 || N > MAX_BOARD_SIZE)
+            {
+                printf("Invalid board size!\n");
+                return 1;
+            }
+            board = initBoardSeeded(N, (uint64_t)strtoul(source[1], NULL, 10));
+        }
+        else
+        {
+            board = loadBoard(source[0]);
+        }
+        i = runPerft(board, depth, divide, reference);
+        freeBoard(board);
+        return i;
+    }
+
+    if (parseOptions(argc, argv))
+    {
+        return 1;
+    }
+
     srand(time(NULL));
     setlocale(LC_ALL, "tr_TR.UTF-8");
 
@@ -1367,7 +7785,7 @@ int main()
             return 1;
         } 
 
-        board = initBoard(N);
+        board = boardSeeded ? initBoardSeeded(N, boardSeed) : initBoard(N);
         saveBoard(board, outfile);
 
         printf(COLOR_BOLD "1-" COLOR_RESET " 1 Player\n" COLOR_BOLD "2-" COLOR_RESET " 2 Players\n" );
@@ -1379,6 +7797,8 @@ int main()
         printf(COLOR_BOLD "Enter the name of the first player: " COLOR_RESET);
         scanf("%s", player1->name);
         player1->type = HUMAN;
+        player1->search = NULL;
+        player2->search = NULL;
         player1->id = 1;
         player1->score = 0;
         for (i = 0; i < 5; i++)
@@ -1413,11 +7833,42 @@ int main()
         printf("Loading game\n");
         printf("Enter the file name: ");
         scanf("%s", outfile);
-        board = loadBoard(outfile);
-        player1 = loadPlayer(outfile, 1);
-        player2 = loadPlayer(outfile, 2);
-        /* load moves for the board */
-        loadMoves(outfile, board, player1, player2, &i);
+        if (isBinarySave(outfile))
+        {
+            SaveGame *game = readBinaryGame(outfile);
+            if (game == NULL)
+            {
+                printf("Invalid save file\n");
+                return 1;
+            }
+            board = copyBoard(game->board);
+            player1 = createPlayer(1, game->players[0]->type, game->players[0]->name);
+            player2 = createPlayer(2, game->players[1]->type, game->players[1]->name);
+            k = replaySaveGame(game, board, player1, player2, &i);
+            if (k >= 0)
+            {
+                printf("Invalid move, x: %d, y: %d, direction: %d\n", game->moves[k].PieceX, game->moves[k].PieceY, game->moves[k].direction);
+                freeSaveGame(game);
+                freeBoard(board);
+                freePlayer(player1);
+                freePlayer(player2);
+                return 1;
+            }
+            freeSaveGame(game);
+        }
+        else
+        {
+            GameLoader loader;
+            if (loadGame(outfile, &loader, NULL) != LOAD_OK)
+            {
+                printLoadError(outfile, &loader);
+                return 1;
+            }
+            board = loader.board;
+            player1 = loader.players[0];
+            player2 = loader.players[1];
+            i = loader.next;
+        }
         /* calculate the score */ 
         loadScores(player1);
         loadScores(player2); 
@@ -1448,8 +7899,8 @@ int main()
     }
 
     freeBoard(board);
-    free(player1);
-    free(player2);
+    freePlayer(player1);
+    freePlayer(player2);
 
     return 0;
 }